@@ -0,0 +1,234 @@
+#include "yaml-cpp/yaml.h"
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#ifndef CALO_BENCH_DIR
+#define CALO_BENCH_DIR "bench"
+#endif
+
+// Figures of merit of a scenario, and whether a larger value is better
+const std::vector<std::pair<std::string, bool>> kMetrics = {
+    {"init_time", false}, {"events_per_s", true}, {"steps_per_s", true}, {"peak_rss", false}, {"bytes_per_event", false}};
+
+// Settings of the scenario override those of default.yaml, key by key
+void Merge(YAML::Node base, const YAML::Node& overrides)
+{
+    for (auto item : overrides)
+    {
+        const std::string key = item.first.as<std::string>();
+        if (item.second.IsMap() && base[key].IsMap())
+            Merge(base[key], item.second);
+        else
+            base[key] = item.second;
+    }
+}
+
+std::string Stem(const std::string& path)
+{
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    return name.substr(0, name.rfind(".yaml"));
+}
+
+// Simulate one scenario in the work directory, and read its figures of merit from the run summary; empty on failure
+std::map<std::string, double> Run(const std::string& scenario, const std::string& work, const std::string& calo)
+{
+    const std::string name = Stem(scenario);
+    YAML::Node conf = YAML::LoadFile(work + "/default.yaml");
+    Merge(conf, YAML::LoadFile(scenario));
+    conf["Global"]["output"] = "./" + name + ".root";
+    conf["Global"]["cache"] = "";
+    conf["Global"]["checkpoint"] = 0;
+    conf["Profile"]["summary"] = name + "_summary.json";
+    {
+        std::ofstream fout(work + "/" + name + ".yaml");
+        fout << conf << std::endl;
+    }
+    std::remove((work + "/" + name + ".root").c_str());
+    std::remove((work + "/" + name + "_summary.json").c_str());
+
+    std::cout << "Running " << name << " (" << conf["Global"]["beamon"].as<long>() << " events)..." << std::endl;
+    std::system(("cd " + work + " && " + calo + " -c " + name + ".yaml > " + name + ".log 2>&1").c_str());
+
+    std::map<std::string, double> metrics;
+    YAML::Node summary;
+    try
+    {
+        // The run summary is JSON, which YAML reads as well
+        summary = YAML::LoadFile(work + "/" + name + "_summary.json");
+    }
+    catch (const YAML::Exception&)
+    {
+        std::cout << "No run summary for " << name << "; see " << work << "/" << name << ".log" << std::endl;
+        return metrics;
+    }
+
+    // Start-up: every top-level phase before the events
+    double init = 0.0;
+    for (auto phase : summary["phases"])
+    {
+        if (phase["name"].as<std::string>() == "events")
+            break;
+        if (phase["depth"].as<int>() == 0)
+            init += phase["wall"].as<double>();
+    }
+    double events = summary["events"].as<double>(0.0);
+    struct stat output;
+    metrics["init_time"] = init;
+    metrics["events_per_s"] = summary["events_per_s"].as<double>(0.0);
+    metrics["steps_per_s"] = metrics["events_per_s"] * summary["steps_per_event"].as<double>(0.0);
+    metrics["peak_rss"] = summary["peak_rss"].as<double>(0.0);
+    metrics["bytes_per_event"] = (events > 0 && stat((work + "/" + name + ".root").c_str(), &output) == 0) ? output.st_size / events : 0.0;
+    return metrics;
+}
+
+int main(int argc, char** argv)
+{
+    std::string output = "bench_report.json", baseline, work = "bench_work", calo = "calo";
+    double tolerance = 0.1;
+    std::vector<std::string> scenarios;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == std::string("-h") || std::string(argv[i]) == std::string("-help"))
+        {
+            std::cout << std::endl;
+            std::cout << "Help information" << std::endl << std::endl;
+            std::cout << "Run the benchmarks:   calo-bench [scenario1.yaml] ...  (default: all scenarios in " << CALO_BENCH_DIR << ")" << std::endl;
+            std::cout << "Report file:          calo-bench -o [report.json] ...  (default: bench_report.json)" << std::endl;
+            std::cout << "Compare:              calo-bench --baseline [report.json] [-t tolerance] ...  (default: 0.1)" << std::endl;
+            std::cout << "Work directory:       calo-bench -w [dir] ...          (default: bench_work)" << std::endl;
+            std::cout << "Executable:           calo-bench --calo [path] ...     (default: calo)" << std::endl << std::endl;
+            std::cout << "Each scenario overrides default.yaml, and is simulated with its fixed seed. The report gives the" << std::endl;
+            std::cout << "start-up time (s), events and steps per second, peak RSS (MB) and output bytes per event." << std::endl;
+            std::cout << "With --baseline, figures worse than the baseline by more than the tolerance are flagged," << std::endl;
+            std::cout << "and the exit code is 1." << std::endl << std::endl;
+            return 1;
+        }
+
+        else if (std::string(argv[i]) == std::string("-o") && i + 1 < argc)
+            output = argv[++i];
+
+        else if (std::string(argv[i]) == std::string("--baseline") && i + 1 < argc)
+            baseline = argv[++i];
+
+        else if (std::string(argv[i]) == std::string("-t") && i + 1 < argc)
+            tolerance = std::stod(argv[++i]);
+
+        else if (std::string(argv[i]) == std::string("-w") && i + 1 < argc)
+            work = argv[++i];
+
+        else if (std::string(argv[i]) == std::string("--calo") && i + 1 < argc)
+            calo = argv[++i];
+
+        else
+            scenarios.emplace_back(argv[i]);
+    }
+
+    if (scenarios.empty())
+    {
+        if (DIR* dir = opendir(CALO_BENCH_DIR))
+        {
+            while (dirent* entry = readdir(dir))
+            {
+                std::string name = entry->d_name;
+                if (name.size() > 5 && name.compare(name.size() - 5, 5, ".yaml") == 0)
+                    scenarios.emplace_back(std::string(CALO_BENCH_DIR) + "/" + name);
+            }
+            closedir(dir);
+        }
+        std::sort(scenarios.begin(), scenarios.end());
+    }
+    if (scenarios.empty())
+    {
+        std::cout << "No scenario found in " << CALO_BENCH_DIR << "!" << std::endl;
+        return 1;
+    }
+
+    // Scenarios only give the settings which differ from the defaults of this version of calo
+    mkdir(work.c_str(), 0755);
+    std::remove((work + "/default.yaml").c_str());
+    if (std::system(("cd " + work + " && " + calo + " -p > /dev/null 2>&1").c_str()) < 0 || !std::ifstream(work + "/default.yaml"))
+    {
+        std::cout << "Could not run " << calo << " -p in " << work << "!" << std::endl;
+        return 1;
+    }
+
+    std::map<std::string, std::map<std::string, double>> results;
+    for (const auto& scenario : scenarios)
+        results[Stem(scenario)] = Run(scenario, work, calo);
+
+    std::ofstream fout(output);
+    fout << std::setprecision(6) << "{";
+    bool first = true;
+    for (const auto& result : results)
+    {
+        fout << (first ? "\n" : ",\n") << "  \"" << result.first << "\": {";
+        bool firstMetric = true;
+        for (const auto& metric : result.second)
+        {
+            fout << (firstMetric ? "" : ", ") << "\"" << metric.first << "\": " << metric.second;
+            firstMetric = false;
+        }
+        fout << "}";
+        first = false;
+    }
+    fout << "\n}\n";
+    fout.close();
+
+    YAML::Node reference;
+    if (!baseline.empty())
+        reference = YAML::LoadFile(baseline);
+
+    std::cout << std::endl << std::left << std::setw(24) << "Scenario";
+    for (const auto& metric : kMetrics)
+        std::cout << std::right << std::setw(18) << metric.first;
+    std::cout << std::endl;
+    int nRegressions = 0, nFailures = 0;
+    for (const auto& result : results)
+    {
+        std::cout << std::left << std::setw(24) << result.first << std::right;
+        if (result.second.empty())
+        {
+            std::cout << "  failed" << std::endl;
+            nFailures++;
+            continue;
+        }
+        for (const auto& metric : kMetrics)
+        {
+            double value = result.second.at(metric.first);
+            std::string flag;
+            // Relative change, positive when worse
+            const YAML::Node& ref = reference;
+            double old = ref[result.first] ? ref[result.first][metric.first].as<double>(0.0) : 0.0;
+            if (old > 0.0)
+            {
+                double change = metric.second ? (old - value) / old : (value - old) / old;
+                if (change > tolerance)
+                {
+                    flag = "!";
+                    nRegressions++;
+                }
+            }
+            std::ostringstream cell;
+            cell << std::setprecision(4) << value << flag;
+            std::cout << std::setw(18) << cell.str();
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::endl << "Report written into " << output << std::endl;
+    if (!baseline.empty())
+        std::cout << nRegressions << " figure(s) worse than " << baseline << " by more than " << 100 * tolerance << "% (marked with !)" << std::endl;
+    if (nFailures > 0)
+        std::cout << nFailures << " scenario(s) failed" << std::endl;
+
+    return (nRegressions > 0 || nFailures > 0) ? 1 : 0;
+}
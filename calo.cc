@@ -11,13 +11,38 @@ G4int main(G4int argc, char** argv)
             std::cout << std::endl;
             std::cout << "Help information" << std::endl << std::endl;
             std::cout << "Produce default.yaml: calo -p" << std::endl;
-            std::cout << "Load a YAML file:     calo -c [file]" << std::endl << std::endl;
+            std::cout << "Load a YAML file:     calo -c [file]" << std::endl;
+            std::cout << "Resume a run:         calo -c [file] --resume" << std::endl;
+            std::cout << "Add N events:         calo -c [file] --extend N [--into sibling.root]" << std::endl;
+            std::cout << "Replay event N:       calo -c [file] --replay N [--verbose]" << std::endl;
+            std::cout << "Navigation benchmark: calo -c [file] --navigation" << std::endl << std::endl;
             return 1;
         }
 
         else if (std::string(argv[i]) == std::string("-c"))
         	config->Parse(std::string(argv[i + 1]));
 
+        else if (std::string(argv[i]) == std::string("--resume"))
+            config->SetResume(true);
+
+        else if (std::string(argv[i]) == std::string("--extend"))
+        {
+            G4int nEvents = std::stoi(argv[i + 1]);
+            std::string sibling = "";
+            if (i + 3 < argc && std::string(argv[i + 2]) == std::string("--into"))
+                sibling = argv[i + 3];
+            config->SetExtend(nEvents, sibling);
+        }
+
+        else if (std::string(argv[i]) == std::string("--replay"))
+        {
+            G4bool verbose = (i + 2 < argc && std::string(argv[i + 2]) == std::string("--verbose"));
+            config->SetReplay(std::stol(argv[i + 1]), verbose);
+        }
+
+        else if (std::string(argv[i]) == std::string("--navigation"))
+            config->SetNavigation(true);
+
         else if (std::string(argv[i]) == std::string("-p"))
         {
             config->Print();
@@ -31,8 +56,9 @@ G4int main(G4int argc, char** argv)
         throw "d";
     }
 
-    else
-        config->Run();
+    // Run() returns 0 when the job was refused or failed
+    else if (!config->Run())
+        return 1;
 
-    return 1;
+    return 0;
 }
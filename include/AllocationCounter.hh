@@ -0,0 +1,70 @@
+#ifndef AllocationCounter_h
+#define AllocationCounter_h 1
+
+// Heap allocations counted by a replacement of the global operator new, per code site of the event loop.
+// Only built with -DWITH_ALLOC_COUNT=ON; otherwise CALO_ALLOC_SCOPE expands to nothing.
+// Sites are counted once the first kWarmUp events have filled the buffers, when they should no longer allocate.
+#ifdef CALO_ALLOC_COUNT
+
+#include <atomic>
+#include <ostream>
+
+class AllocationCounter
+{
+public:
+    static const int kWarmUp = 10;
+
+    // A code site, registered on first use
+    class Site
+    {
+    public:
+        Site(const char* name);
+
+        const char* fName;
+        std::atomic<long> fCalls;
+        std::atomic<long> fAllocations;
+        std::atomic<long> fBytes;
+    };
+
+    // Allocations between construction and destruction, added to the site
+    class Scope
+    {
+    public:
+        Scope(Site& site) : fSite(site), fAllocations(fgAllocations), fBytes(fgBytes) {}
+
+        ~Scope()
+        {
+            fSite.fCalls.fetch_add(1, std::memory_order_relaxed);
+            fSite.fAllocations.fetch_add(fgAllocations - fAllocations, std::memory_order_relaxed);
+            fSite.fBytes.fetch_add(fgBytes - fBytes, std::memory_order_relaxed);
+        }
+
+    private:
+        Site& fSite;
+        long  fAllocations;
+        long  fBytes;
+    };
+
+    // Clear the sites, at the end of the warm-up
+    static void Reset();
+
+    // Allocations per event of each site over nEvents, flagging those which should not allocate at all
+    static void Print(std::ostream& out, const long& nEvents);
+
+    // Allocations and bytes requested by the calling thread since it started
+    static thread_local long fgAllocations;
+    static thread_local long fgBytes;
+};
+
+#define CALO_ALLOC_CONCAT_(a, b) a##b
+#define CALO_ALLOC_CONCAT(a, b) CALO_ALLOC_CONCAT_(a, b)
+#define CALO_ALLOC_SCOPE(name) static AllocationCounter::Site CALO_ALLOC_CONCAT(allocSite, __LINE__)(name); \
+                               AllocationCounter::Scope CALO_ALLOC_CONCAT(allocScope, __LINE__)(CALO_ALLOC_CONCAT(allocSite, __LINE__))
+
+#else
+
+#define CALO_ALLOC_SCOPE(name)
+
+#endif
+
+#endif
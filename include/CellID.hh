@@ -0,0 +1,65 @@
+#ifndef CellID_h
+#define CellID_h 1
+
+#include <cstdint>
+
+// 64-bit cell ID of the calorimeter readout, shared by the geometry, the digitisation, calo-overlay and analysis macros.
+// Bit fields, from the most significant: subdetector (4 bits), layer, x and y (20 bits each).
+// Copy numbers in the geometry are dense 32-bit indices within a subdetector, and are turned into cell IDs at readout.
+class CellID
+{
+public:
+    enum Subdetector : std::uint64_t { kNone = 0, kEcal = 1, kHcal = 2 };
+
+    static constexpr unsigned kFieldBits = 20;
+    static constexpr std::uint64_t kFieldMask = (std::uint64_t(1) << kFieldBits) - 1;
+    // Largest number of layers, or of cells along x or y
+    static constexpr std::uint64_t kMaxCells = kFieldMask + 1;
+
+    // Never a valid cell: its subdetector is kNone
+    static constexpr std::uint64_t kInvalid = 0;
+
+    static constexpr std::uint64_t Encode(const std::uint64_t& subdetector, const std::uint64_t& layer, const std::uint64_t& x, const std::uint64_t& y)
+    {
+        return (subdetector << (3 * kFieldBits)) | ((layer & kFieldMask) << (2 * kFieldBits)) | ((x & kFieldMask) << kFieldBits) | (y & kFieldMask);
+    }
+
+    static constexpr std::uint64_t GetSubdetector(const std::uint64_t& id)
+    {
+        return id >> (3 * kFieldBits);
+    }
+
+    static constexpr int GetLayer(const std::uint64_t& id)
+    {
+        return static_cast<int>((id >> (2 * kFieldBits)) & kFieldMask);
+    }
+
+    static constexpr int GetX(const std::uint64_t& id)
+    {
+        return static_cast<int>((id >> kFieldBits) & kFieldMask);
+    }
+
+    static constexpr int GetY(const std::uint64_t& id)
+    {
+        return static_cast<int>(id & kFieldMask);
+    }
+
+    // Dense copy number of a cell in a subdetector of nX x nY cells per layer
+    static constexpr int CopyNo(const int& layer, const int& x, const int& y, const int& nX, const int& nY)
+    {
+        return (layer * nX + x) * nY + y;
+    }
+
+    static constexpr std::uint64_t FromCopyNo(const std::uint64_t& subdetector, const int& copyNo, const int& nX, const int& nY)
+    {
+        return Encode(subdetector, copyNo / (nX * nY), (copyNo / nY) % nX, copyNo % nY);
+    }
+
+    // Whether a subdetector of this size can be numbered, both with 32-bit copy numbers and with the bit fields
+    static constexpr bool Fits(const std::uint64_t& nLayer, const std::uint64_t& nX, const std::uint64_t& nY)
+    {
+        return nLayer <= kMaxCells && nX <= kMaxCells && nY <= kMaxCells && nLayer * nX * nY <= 0x7FFFFFFFULL;
+    }
+};
+
+#endif
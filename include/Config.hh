@@ -11,7 +11,17 @@
 #include "SteppingAction.hh"
 #include "PrimaryGeneratorAction.hh"
 #include "TrackingAction.hh"
+#include "StackingAction.hh"
+#include "ShowerLibrary.hh"
+#include "StepProfiler.hh"
+#include "PerfCounters.hh"
+#include "RunSummary.hh"
+#include "ProgressMetrics.hh"
+#include "Trace.hh"
+#include "NavigationBenchmark.hh"
 #include "QGSP_BERT.hh"
+#include "G4FastSimulationPhysics.hh"
+#include "G4EmParameters.hh"
 #include "G4GDMLParser.hh"
 #include "G4VisExecutive.hh"
 #include "G4UIExecutive.hh"
@@ -20,6 +30,8 @@
 #include <vector>
 #include <fstream>
 #include <ctime>
+#include <cstdint>
+#include <csignal>
 #include "yaml-cpp/yaml.h"
 
 class Config
@@ -33,8 +45,101 @@ public:
 	bool IsLoad();
 	YAML::Node conf;
 
+    // Hash of every setting that affects the simulated events; samples with equal hashes can be merged
+    std::uint64_t GetConfigHash();
+    // Hash of everything which determines the output file, including the seed, number of events and program versions
+    std::uint64_t GetSampleHash();
+    G4long GetSeed() const
+    {
+        return fSeed;
+    }
+
+    // Seed of one random stream of an event (0: Geant4, 1: digitisation), derived from the run seed and event ID only
+    std::uint64_t GetEventSeed(const G4long& eventID, const G4int& stream = 0) const;
+
+    // Continue the run from the checkpoint stored in the output file
+    void SetResume(const G4bool& resume)
+    {
+        fResume = resume;
+    }
+
+    // Simulate nEvents more events after the final checkpoint of the output file, appended to it,
+    // or written into sibling if given
+    void SetExtend(const G4int& nEvents, const std::string& sibling)
+    {
+        fExtend = nEvents;
+        fSibling = sibling;
+    }
+
+    // Simulate event eventID alone, with verbose tracking if requested
+    void SetReplay(const G4long& eventID, const G4bool& verbose)
+    {
+        fReplay = eventID;
+        fReplayVerbose = verbose;
+    }
+
+    // Shoot the geantinos of the Navigation section through the detector instead of simulating the events
+    void SetNavigation(const G4bool& navigation)
+    {
+        fNavigation = navigation;
+    }
+
+    // Global number of the first event simulated by this run
+    G4long GetFirstEvent() const
+    {
+        return fFirstEvent;
+    }
+
+    // Events simulated by the run, set at its end
+    void SetProcessedEvents(const G4long& nEvents)
+    {
+        fProcessed = nEvents;
+    }
+
+    // Timing and memory of the phases of the job, printed at its end
+    RunSummary& GetSummary()
+    {
+        return fSummary;
+    }
+
+    // SIGTERM or SIGUSR1 received since the last call of ClearSignal(), 0 if none
+    static G4int PendingSignal()
+    {
+        return fSignal;
+    }
+
+    static void ClearSignal()
+    {
+        fSignal = 0;
+    }
+
 private:
 	G4UImanager* UI;
+	G4long fSeed;
+	G4bool fResume;
+	G4int fExtend;
+	std::string fSibling;
+	G4long fReplay;
+	G4bool fReplayVerbose;
+	G4bool fNavigation;
+	G4long fFirstEvent;
+	G4long fProcessed;
+	RunSummary fSummary;
+	// Geometry benchmark of SetNavigation(), with the detector already given to the run manager
+	G4int RunNavigation(G4RunManager* runManager);
+	// Print the phases of the job, and write them into Profile/summary if set
+	void WriteSummary();
+	static volatile std::sig_atomic_t fSignal;
+	// Content-addressed cache of samples, see Global/cache
+	std::string GetCachePath();
+	void LogCache(const std::string& action, const std::string& output);
+	G4bool FetchFromCache(const std::string& output);
+	void StoreInCache(const std::string& output);
+
+	static void HandleSignal(G4int signal)
+	{
+	    fSignal = signal;
+	}
 	G4long GetTimeNs()
 	{
 		struct timespec ts;
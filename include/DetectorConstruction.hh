@@ -7,6 +7,15 @@
 #include "Config.hh"
 
 class Config;
+class G4Region;
+class G4Material;
+class G4LogicalVolume;
+class GFlashShowerModel;
+class GFlashHitMaker;
+class GFlashParticleBounds;
+class GVFlashShowerParameterisation;
+class FrozenShowerModel;
+
 class DetectorConstruction : public G4VUserDetectorConstruction
 {
   public:
@@ -15,6 +24,7 @@ class DetectorConstruction : public G4VUserDetectorConstruction
 
     virtual     
     G4VPhysicalVolume* Construct();
+    virtual void ConstructSDandField();
                         
     G4double GetWorldSize()
     {
@@ -25,6 +35,17 @@ class DetectorConstruction : public G4VUserDetectorConstruction
 	{
 	    return this->physiWorld;
 	}
+
+    // Active volumes, whose copy numbers are the cell IDs of the readout
+    G4LogicalVolume* GetEcalActive() const
+    {
+        return fEcalCrystal;
+    }
+
+    G4LogicalVolume* GetHcalActive() const
+    {
+        return fHcalActive;
+    }
     
   private:
     G4double fWorldSize;
@@ -34,7 +55,28 @@ class DetectorConstruction : public G4VUserDetectorConstruction
     G4VisAttributes* visAttributes;
 	void ConstructECAL();
 	void ConstructHCAL();
+    // Region of an envelope; the store keeps one region per name, so it is reused when the geometry is built again
+    G4Region* EnvelopeRegion(const G4String& name, G4LogicalVolume* envelope);
 	Config *config;
+
+    // ECAL envelope region and parameters of the GFlash fast simulation
+    G4Region* fEcalRegion;
+    G4LogicalVolume* fEcalCrystal;
+    G4Material* fEcalAbsorberMaterial;
+    G4Material* fEcalActiveMaterial;
+    G4double fEcalAbsorberZ;
+    G4double fEcalActiveZ;
+    GFlashShowerModel* fGFlashModel;
+    GFlashHitMaker* fGFlashHitMaker;
+    GFlashParticleBounds* fGFlashBounds;
+    GVFlashShowerParameterisation* fGFlashParameterisation;
+
+    // HCAL envelope region, where the frozen-shower model applies
+    G4Region* fHcalRegion;
+    G4LogicalVolume* fHcalActive;
+    G4double fHcalFront;        // Front of the first layer
+    G4double fHcalThickness;    // Of one layer
+    FrozenShowerModel* fFrozenShowerModel;
    // G4double ABDd;
    // G4double crystalsize;
 };
@@ -0,0 +1,81 @@
+#ifndef Digitizer_h
+#define Digitizer_h 1
+
+#include "CellID.hh"
+#include "Rtypes.h"
+#include "TRandom.h"
+#include "yaml-cpp/yaml.h"
+#include <unordered_map>
+#include <vector>
+
+// Readout of the calorimeter cells: SiPM response, threshold and cell positions.
+// ECAL strips and HCAL tiles share one cell ID space, and are digitised into the same hit vectors.
+class Digitizer
+{
+public:
+    // Cells of the ECAL and HCAL sections of the configuration
+    Digitizer(const YAML::Node& conf, const double& threshold = 0.1);
+
+    // Cell ID of an ECAL strip or HCAL tile from its copy number (CellID::CopyNo) in the geometry.
+    // For the strips, x counts across and y along the strips, whatever the orientation of the layer.
+    ULong64_t GetCellID(const CellID::Subdetector& subdetector, const int& copyNo) const
+    {
+        if (subdetector == CellID::kEcal)
+            return CellID::FromCopyNo(CellID::kEcal, copyNo, fNStripX, fNStripY);
+        return CellID::FromCopyNo(CellID::kHcal, copyNo, fNCellX, fNCellY);
+    }
+
+    // Add a deposit in MeV to the cell of a copy number; the hit accumulation of calo, also replayed by calo-readout-bench
+    void Deposit(std::unordered_map<ULong64_t, double>& cells, const CellID::Subdetector& subdetector, const int& copyNo, const double& edep) const
+    {
+        cells[GetCellID(subdetector, copyNo)] += edep;
+    }
+
+    // Length in mm reserved for the ECAL in front of the HCAL, 0 without ECAL
+    static double EcalLength(const YAML::Node& conf);
+
+    int GetNCellX() const
+    {
+        return fNCellX;
+    }
+
+    int GetNCellY() const
+    {
+        return fNCellY;
+    }
+
+    // The HCAL cell mirrored and shifted by whole cells, or CellID::kInvalid if it falls outside the HCAL.
+    // Strips of the ECAL cannot be shifted by HCAL cells, and are also invalid unless the shift is null.
+    ULong64_t Shift(const ULong64_t& cellID, const int& dx, const int& dy, const bool& mirrorX = false, const bool& mirrorY = false) const;
+
+    // Centre of a cell in mm; z is the front of the layer for the HCAL and the centre of the strip for the ECAL
+    void Position(const ULong64_t& cellID, double& x, double& y, double& z) const;
+
+    // SiPM response to a deposit in MeV, 0 below half a MIP
+    double SiPM(const double& edep, TRandom& random) const;
+
+    // Digitise the deposits (MeV by cell ID) above the threshold into the hit vectors, which are cleared first
+    void Digitise(const std::unordered_map<ULong64_t, double>& cells, TRandom& random,
+                  std::vector<ULong64_t>& cellID, std::vector<double>& energy,
+                  std::vector<double>& x, std::vector<double>& y, std::vector<double>& z) const;
+
+private:
+    // HCAL
+    int    fNCellX;
+    int    fNCellY;
+    double fPitchX;
+    double fPitchY;
+    double fLayerThickness;
+    double fFront;
+    // ECAL
+    int    fNStripX;
+    int    fNStripY;
+    double fStripPitchX;
+    double fStripPitchY;
+    double fStripThickness;
+    double fEcalLayerThickness;
+
+    double fThreshold;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef EcalGFlashSD_h
+#define EcalGFlashSD_h 1
+
+#include "G4VSensitiveDetector.hh"
+#include "G4VGFlashSensitiveDetector.hh"
+#include "globals.hh"
+
+class G4Step;
+class G4TouchableHistory;
+class G4GFlashSpot;
+class G4LogicalVolume;
+
+// Books the energy spots of GFlash showers, like SteppingAction does for full simulation: every spot enters
+// the energy balance, and those in the strips (active) the hits
+class EcalGFlashSD : public G4VSensitiveDetector, public G4VGFlashSensitiveDetector
+{
+public:
+    EcalGFlashSD(const G4String& name, G4LogicalVolume* active);
+    virtual ~EcalGFlashSD();
+
+    // Steps are already booked by SteppingAction
+    virtual G4bool ProcessHits(G4Step*, G4TouchableHistory*);
+    virtual G4bool ProcessHits(G4GFlashSpot* aSpot, G4TouchableHistory*);
+
+private:
+    G4LogicalVolume* fActive;
+};
+
+#endif
@@ -10,7 +10,10 @@
 #include "DetectorConstruction.hh"
 #include "Config.hh"
 #include "TMath.h"
-#include "TRandom.h"
+#include "TRandom3.h"
+#include "Digitizer.hh"
+#include "StepStream.hh"
+#include <chrono>
 
 class EventAction : public G4UserEventAction
 {
@@ -18,6 +21,9 @@ public:
     EventAction(HistoManager*, Config* c);
     ~EventAction();
 
+    // Bits of the Status branch
+    enum Budget { kTrackSteps = 1, kTrackTime = 2, kEventWall = 4 };
+
 public:
     virtual void BeginOfEventAction(const G4Event*);
     virtual void   EndOfEventAction(const G4Event*);
@@ -33,8 +39,50 @@ public:
         fDecayChain += val;
     }
 
-//    void AddEcalHit(const G4int& copyNo, const G4double& edep, const G4double &time, const G4int& pdgid, const G4int& trackid);
-    void AddHcalHit(const G4int& copyNo, const G4double& edep, const G4double &time, const G4int& pdgid, const G4int& trackid);
+    // Deposit in an ECAL strip or HCAL tile, given by its copy number in the geometry
+    void AddHit(const CellID::Subdetector& subdetector, const G4int& copyNo, const G4double& edep)
+    {
+        CALO_ALLOC_SCOPE("EventAction::AddHit");
+        fDigitizer->Deposit(fHistoManager_Event->fParticleInfo.fhit_mape, subdetector, copyNo, edep);
+        if (fStepStream)
+            fStepStream->Write(subdetector, copyNo, edep);
+    }
+
+    // Energy balance
+    void AddEdep(const G4double& edep, const G4bool& active)
+    {
+        if (active)
+            fHistoManager_Event->fParticleInfo.fEdepActive += edep;
+        else
+            fHistoManager_Event->fParticleInfo.fEdepPassive += edep;
+    }
+
+    void AddLocalDeposit(const G4double& energy)
+    {
+        fHistoManager_Event->fParticleInfo.fEdepLocal += energy;
+        fNLocal++;
+    }
+
+    // Weights of the tracks depositing in active volumes, averaged with their unweighted deposits
+    void AddWeight(const G4double& edep, const G4double& weight)
+    {
+        fWeightedEdep += weight * edep;
+        fUnweightedEdep += edep;
+    }
+
+    void AddRouletteKill()
+    {
+        fNRoulette++;
+    }
+
+    // Log a track killed, or the event aborted, for exceeding its budget
+    void ExceedBudget(const Budget& budget, const G4Track* track);
+
+    // Wall-clock time of the current event in s
+    G4double GetWallTime() const
+    {
+        return std::chrono::duration<G4double>(std::chrono::steady_clock::now() - fEventStart).count();
+    }
 
     //void AddCrystalEnDep(G4int copyNo, G4double edep)
     //{
@@ -49,13 +97,36 @@ public:
     //}
 
 private:
-    Double_t SiPMDigi(const Double_t& edep) const;
+    Double_t SiPMDigi(const Double_t& edep);
+    // Digitise the cells into the output vectors, optionally mirrored and shifted by whole HCAL cells
+    void FillHits(const G4int& dx, const G4int& dy, const G4bool& mirrorX, const G4bool& mirrorY);
+    // Write the augmented copies of the current event
+    void Augment(const G4long& evtNb);
+    // Log the seed and primaries of an event slower than Profile/slow_percentile
+    void DumpSlowEvent(const G4Event* evt);
     G4double      fEventEdep;
     G4int         fPrintModulo;
+    G4int         fCheckpoint;
+    G4int         fNLocal;
+    G4int         fNRoulette;
+    G4int         fNKilledTracks;
+    std::chrono::steady_clock::time_point fEventStart;
+    G4double      fCpuStart;
+    G4long        fStepStart;
+    G4double      fWeightedEdep;
+    G4double      fUnweightedEdep;
     G4String      fDecayChain;
     HistoManager* fHistoManager_Event;
     Config*       config;
     G4GeneralParticleSource* fGParticleSource;
+    TRandom3      fDigiRandom;
+    TRandom3      fAugmentRandom;
+    Digitizer*    fDigitizer;
+    StepStream*   fStepStream;
+    G4bool        fSaveRaw;
+    G4int         fCopies;
+    G4int         fMargin;
+    G4bool        fMirror;
 };
 
 #endif
@@ -0,0 +1,27 @@
+#ifndef FrozenShowerModel_h
+#define FrozenShowerModel_h 1
+
+#include "G4VFastSimulationModel.hh"
+#include "globals.hh"
+
+class G4Navigator;
+class ShowerLibrary;
+
+// Replaces e+/e-/gamma in the HCAL by showers drawn from the frozen-shower library,
+// whose deposits are booked into the cells directly
+class FrozenShowerModel : public G4VFastSimulationModel
+{
+public:
+    FrozenShowerModel(const G4String& name, G4Region* region, ShowerLibrary* library);
+    ~FrozenShowerModel();
+
+    virtual G4bool IsApplicable(const G4ParticleDefinition& particle);
+    virtual G4bool ModelTrigger(const G4FastTrack& fastTrack);
+    virtual void DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep);
+
+private:
+    ShowerLibrary* fLibrary;
+    G4Navigator*   fNavigator;
+};
+
+#endif
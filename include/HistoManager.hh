@@ -8,6 +8,8 @@
 #include "g4root.hh"
 #include <G4ThreeVector.hh>
 #include <unordered_map>
+#include <cstdint>
+#include "AllocationCounter.hh"
 
 class TTree;
 class TFile;
@@ -18,6 +20,28 @@ class ParticleInfo
 public:
     G4int fPrimaryPDG;
     G4double fPrimaryEnergy;
+    Long64_t fEventID;
+    ULong64_t fEventSeed;
+    // Energy balance: deposits in active and passive volumes, and energy of the particles killed by the local-deposition approximation
+    G4double fEdepActive;
+    G4double fEdepPassive;
+    G4double fEdepLocal;
+    // Mean weight of the tracks depositing in active volumes, 1 without biasing; the hit energies already include the weights
+    G4double fWeight;
+    // Bits of the budgets exceeded (EventAction::Budget): tracks killed, or the event aborted
+    G4int fStatus;
+    // 0 for the simulated event, 1..K for its shifted copies (same EventID)
+    G4int fCopyID;
+    // Wall-clock and CPU time in s, steps and cells with deposits of the event, with Profile/events
+    G4double fWallTime;
+    G4double fCpuTime;
+    Long64_t fNSteps;
+    G4int fNCells;
+    // Hardware counters of the event, with Profile/events and Profile/counters
+    G4double fCycles;
+    G4double fInstructions;
+    G4double fCacheMisses;
+    G4double fBranchMisses;
     /*
     std::vector<G4int> fecal_pdgid;
     std::vector<G4int> fecal_trackid;
@@ -27,12 +51,6 @@ public:
     std::vector<G4double> fecal_time;
     std::vector<G4int> fecal_psdid;
     std::vector<G4double> fecal_energy;
-    std::vector<G4int> fecal_cellid;
-    std::vector<G4double> fecal_celle;
-    std::vector<G4double> fecal_cellx;
-    std::vector<G4double> fecal_celly;
-    std::vector<G4double> fecal_cellz;
-    std::unordered_map<G4int, G4double> fecal_mape;
     */
 //    std::vector<G4int> fhcal_pdgid;
 //    std::vector<G4int> fhcal_trackid;
@@ -42,16 +60,22 @@ public:
 //    std::vector<G4double> fhcal_time;
 //    std::vector<G4int> fhcal_psdid;
 //    std::vector<G4double> fhcal_energy;
-    std::vector<G4int> fhcal_cellid;
+    // Digitised hits of the ECAL and the HCAL, and their deposits by 64-bit cell ID (CellID)
+    std::vector<ULong64_t> fhit_cellid;
 //    std::vector<G4double> fhcal_celle_nodigi;
-    std::vector<G4double> fhcal_celle;
-    std::vector<G4double> fhcal_cellx;
-    std::vector<G4double> fhcal_celly;
-    std::vector<G4double> fhcal_cellz;
-    std::unordered_map<G4int, G4double> fhcal_mape;
+    std::vector<G4double> fhit_energy;
+    std::vector<G4double> fhit_x;
+    std::vector<G4double> fhit_y;
+    std::vector<G4double> fhit_z;
+    std::unordered_map<ULong64_t, G4double> fhit_mape;
+    // Deposits before digitisation, with Global/saveraw
+    std::vector<ULong64_t> fraw_cellid;
+    std::vector<G4double> fraw_energy;
 
+    // Contents are cleared, but the capacity of the buffers is kept for the next event
     void reset()
     {
+        CALO_ALLOC_SCOPE("ParticleInfo::reset");
         /*
         std::vector<G4int>().swap(fecal_pdgid);
         std::vector<G4int>().swap(fecal_trackid);
@@ -61,11 +85,6 @@ public:
         std::vector<G4double>().swap(fecal_time);
         std::vector<G4int>().swap(fecal_psdid);
         std::vector<G4double>().swap(fecal_energy);
-        std::vector<G4int>().swap(fecal_cellid);
-        std::vector<G4double>().swap(fecal_celle);
-        std::vector<G4double>().swap(fecal_cellx);
-        std::vector<G4double>().swap(fecal_celly);
-        std::vector<G4double>().swap(fecal_cellz);
         */
 //        std::vector<G4int>().swap(fhcal_pdgid);
 //        std::vector<G4int>().swap(fhcal_trackid);
@@ -75,16 +94,33 @@ public:
 //        std::vector<G4double>().swap(fhcal_time);
 //        std::vector<G4int>().swap(fhcal_psdid);
 //        std::vector<G4double>().swap(fhcal_energy);
-        std::vector<G4int>().swap(fhcal_cellid);
+        fhit_cellid.clear();
 //        std::vector<G4double>().swap(fhcal_celle_nodigi);
-        std::vector<G4double>().swap(fhcal_celle);
-        std::vector<G4double>().swap(fhcal_cellx);
-        std::vector<G4double>().swap(fhcal_celly);
-        std::vector<G4double>().swap(fhcal_cellz);
-//        fecal_mape.clear();
-        fhcal_mape.clear();
+        fhit_energy.clear();
+        fhit_x.clear();
+        fhit_y.clear();
+        fhit_z.clear();
+        fraw_cellid.clear();
+        fraw_energy.clear();
+        fhit_mape.clear();
+        fEdepActive = fEdepPassive = fEdepLocal = 0.0;
+        fWeight = 1.0;
+        fStatus = 0;
+        fCopyID = 0;
+        fWallTime = fCpuTime = 0.0;
+        fNSteps = 0;
+        fNCells = 0;
+        fCycles = fInstructions = fCacheMisses = fBranchMisses = 0.0;
     };
 
+    // Bytes held by the hit buffers and the deposit map, whether in use or not
+    std::size_t GetCapacityBytes() const
+    {
+        return (fhit_cellid.capacity() + fraw_cellid.capacity()) * sizeof(ULong64_t)
+             + (fhit_energy.capacity() + fhit_x.capacity() + fhit_y.capacity() + fhit_z.capacity() + fraw_energy.capacity()) * sizeof(G4double)
+             + fhit_mape.bucket_count() * sizeof(void*) + fhit_mape.size() * (sizeof(ULong64_t) + sizeof(G4double) + 2 * sizeof(void*));
+    }
+
     ParticleInfo()
     {
         /*
@@ -96,11 +132,6 @@ public:
         std::vector<G4double>().swap(fecal_time);
         std::vector<G4int>().swap(fecal_psdid);
         std::vector<G4double>().swap(fecal_energy);
-        std::vector<G4int>().swap(fecal_cellid);
-        std::vector<G4double>().swap(fecal_celle);
-        std::vector<G4double>().swap(fecal_cellx);
-        std::vector<G4double>().swap(fecal_celly);
-        std::vector<G4double>().swap(fecal_cellz);
         */
 //        std::vector<G4int>().swap(fhcal_pdgid);
 //        std::vector<G4int>().swap(fhcal_trackid);
@@ -110,33 +141,80 @@ public:
 //        std::vector<G4double>().swap(fhcal_time);
 //        std::vector<G4int>().swap(fhcal_psdid);
 //        std::vector<G4double>().swap(fhcal_energy);
-        std::vector<G4int>().swap(fhcal_cellid);
+        std::vector<ULong64_t>().swap(fhit_cellid);
 //        std::vector<G4double>().swap(fhcal_celle_nodigi);
-        std::vector<G4double>().swap(fhcal_celle);
-        std::vector<G4double>().swap(fhcal_cellx);
-        std::vector<G4double>().swap(fhcal_celly);
-        std::vector<G4double>().swap(fhcal_cellz);
-//        fecal_mape.clear();
-        fhcal_mape.clear();
+        std::vector<G4double>().swap(fhit_energy);
+        std::vector<G4double>().swap(fhit_x);
+        std::vector<G4double>().swap(fhit_y);
+        std::vector<G4double>().swap(fhit_z);
+        std::vector<ULong64_t>().swap(fraw_cellid);
+        std::vector<G4double>().swap(fraw_energy);
+        fhit_mape.clear();
+        fEdepActive = fEdepPassive = fEdepLocal = 0.0;
+        fWeight = 1.0;
+        fStatus = 0;
+        fCopyID = 0;
+        fWallTime = fCpuTime = 0.0;
+        fNSteps = 0;
+        fNCells = 0;
+        fCycles = fInstructions = fCacheMisses = fBranchMisses = 0.0;
     }
 };
 
+// Provenance of the events written by one run, one entry per run in the RunInfo tree
+class RunInfo
+{
+public:
+    ULong64_t fConfigHash;
+    Long64_t  fSeed;
+    G4int     fShard;
+    Long64_t  fFirstEvent;
+    Long64_t  fNEvents;        // Simulated events
+    Long64_t  fNEntries;       // Entries of the event tree, more than the events when they are augmented
+    Long64_t  fEntryOffset;
+
+    RunInfo()
+     : fConfigHash(0), fSeed(0), fShard(0), fFirstEvent(0), fNEvents(0), fNEntries(0), fEntryOffset(0)
+    {}
+};
+
 class HistoManager
 {
 public:
-    HistoManager(const char* foutname, const G4bool& savegeo);
+    HistoManager(const char* foutname, const G4bool& savegeo, const G4bool& saveraw = false, const G4bool& saveevents = false);
     ~HistoManager();
-    void save();
+    void save(const Long64_t& nextEvent);
     void book();
+
+    // Save the tree and the state of the random engine, so that a run can continue from nextEvent
+    void checkpoint(const Long64_t& nextEvent);
+    // Restore the random engine from the checkpoint in source, and return the next event;
+    // the output continues source when it is the same file, otherwise it starts a new file at that event
+    Long64_t restore(const std::uint64_t& configHash, G4long& seed, const G4String& source);
+    // Provenance of the run of source which simulated event; false if source records no such run
+    static G4bool findRun(const G4String& source, const Long64_t& event, RunInfo& run);
+
+    // Bytes of the baskets kept in memory by the event tree, one per branch until it is flushed
+    Long64_t GetBasketBytes() const;
+
     ParticleInfo fParticleInfo;
+    RunInfo fRunInfo;
 
 private:
+    // Create a branch, or connect to the existing one when continuing a file
+    template <typename T>
+    void Attach(TTree* tree, const char* name, T* address, const char* leaflist = nullptr);
+
     G4bool   fSaveGeo;
+    G4bool   fSaveRaw;
+    G4bool   fSaveEvents;
+    G4bool   fResume;
     G4String fOutName;
 
 public:
     TFile* fRootFile;
     TTree* fNtuple;
+    TTree* fRunTree;
 };
 
 #endif
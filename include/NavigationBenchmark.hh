@@ -0,0 +1,81 @@
+#ifndef NavigationBenchmark_h
+#define NavigationBenchmark_h 1
+
+#include "globals.hh"
+#include "G4RunManager.hh"
+#include "G4VUserPrimaryGeneratorAction.hh"
+#include "G4UserRunAction.hh"
+#include "G4UserTrackingAction.hh"
+#include "G4ParticleGun.hh"
+#include "G4ThreeVector.hh"
+#include <vector>
+
+class Config;
+
+// Geometry benchmark of calo --navigation, run instead of the simulation. Geantinos and charged geantinos,
+// which only have the transportation, are shot through the detector from the grid of positions and angles
+// of the Navigation section, so that the steps per second measure the navigation alone. The voxelisation
+// of every logical volume with daughters (memory, slices, nodes, smartless) is reported before.
+class NavigationBenchmark
+{
+public:
+    NavigationBenchmark(Config* c);
+    ~NavigationBenchmark();
+
+    // Register the primary generator, run and tracking actions, before the run manager is initialised
+    void SetUserActions(G4RunManager* runManager);
+
+    // Voxelisation report, then repeated passes over the grid with every particle
+    void Run(G4RunManager* runManager);
+
+private:
+    // Every ray of the grid as a primary vertex of the event
+    class Gun : public G4VUserPrimaryGeneratorAction
+    {
+    public:
+        Gun(NavigationBenchmark* benchmark) : fBenchmark(benchmark) {}
+        virtual void GeneratePrimaries(G4Event* event);
+
+    private:
+        NavigationBenchmark* fBenchmark;
+    };
+
+    // Wall and CPU time of the event loop, without the physics tables built before the run
+    class Timer : public G4UserRunAction
+    {
+    public:
+        Timer(NavigationBenchmark* benchmark) : fBenchmark(benchmark) {}
+        virtual void BeginOfRunAction(const G4Run*);
+        virtual void EndOfRunAction(const G4Run*);
+
+    private:
+        NavigationBenchmark* fBenchmark;
+    };
+
+    // Steps counted once per track, to keep the stepping free of user code
+    class Counter : public G4UserTrackingAction
+    {
+    public:
+        Counter(NavigationBenchmark* benchmark) : fBenchmark(benchmark) {}
+        virtual void PostUserTrackingAction(const G4Track* track);
+
+    private:
+        NavigationBenchmark* fBenchmark;
+    };
+
+    // Voxel headers of every logical volume, printed largest first
+    void ReportVoxels();
+
+    Config*  config;
+    G4ParticleGun* fGun;
+    std::vector<std::pair<G4ThreeVector, G4ThreeVector>> fRays;    // Position and direction
+    std::vector<G4String> fParticles;
+    G4int    fNRepeat;
+    G4int    fNReport;
+
+    G4long   fNSteps;
+    G4double fWallTime;    // In s
+    G4double fCpuTime;     // In s
+};
+
+#endif
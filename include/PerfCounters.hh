@@ -0,0 +1,103 @@
+#ifndef PerfCounters_h
+#define PerfCounters_h 1
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Hardware counters of the Linux perf_event_open interface, with Profile/counters.
+// Each thread opens its own counters on first use, counting that thread alone in user and kernel space.
+// Counters the kernel or the machine does not offer (containers, virtual machines, perf_event_paranoid) read 0,
+// and the simulation runs on.
+class PerfCounters
+{
+public:
+    enum Counter { kCycles, kInstructions, kCacheMisses, kBranchMisses, kNCounters };
+
+    class Sample
+    {
+    public:
+        double fCount[kNCounters] = {};
+
+        Sample operator-(const Sample& other) const
+        {
+            Sample result;
+            for (int i = 0; i < kNCounters; i++)
+                result.fCount[i] = fCount[i] - other.fCount[i];
+            return result;
+        }
+
+        Sample& operator+=(const Sample& other)
+        {
+            for (int i = 0; i < kNCounters; i++)
+                fCount[i] += other.fCount[i];
+            return *this;
+        }
+
+        double IPC() const
+        {
+            return fCount[kCycles] > 0.0 ? fCount[kInstructions] / fCount[kCycles] : 0.0;
+        }
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    static PerfCounters* Instance();
+
+    static const char* GetName(const int& counter);
+
+    // Whether the counter could be opened in the first thread
+    bool IsAvailable(const int& counter) const
+    {
+        return fAvailable[counter];
+    }
+
+    bool IsAvailable() const;
+
+    // Counts of the calling thread since its counters were opened, scaled up if the kernel multiplexed them
+    Sample Read();
+
+    // Counts of the events of each thread, cleared at the start of the run
+    void BeginOfRun();
+    void BeginOfEvent();
+    // Counts of the event of the calling thread, which are added to its totals
+    Sample EndOfEvent(const long& nSteps);
+
+    // Totals by thread and per step, with the events per second over wall s
+    void Print(std::ostream& out, const double& wall);
+    // Totals of all threads
+    Sample GetTotal(long& nEvents, long& nSteps);
+
+private:
+    class Thread
+    {
+    public:
+        int    fFd[kNCounters];
+        Sample fStart;
+        Sample fTotal;
+        long   fNEvents = 0;
+        long   fNSteps = 0;
+    };
+
+    Thread& GetThread()
+    {
+        if (!fgThread)
+            Open();
+        return *fgThread;
+    }
+
+    void Open();
+
+    static PerfCounters* fgInstance;
+    static thread_local Thread* fgThread;
+
+    bool fAvailable[kNCounters];
+    bool fFirst;
+    int  fError;    // errno of the first counter which could not be opened
+    std::vector<Thread*> fThreads;
+    std::mutex fMutex;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef ProgressMetrics_h
+#define ProgressMetrics_h 1
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Progress of the job for batch monitoring, with Profile/metrics: events done, events and steps per second, ETA,
+// peak RSS and bytes written. The events only update counters; a timer thread rewrites the file every
+// Profile/metrics_interval seconds, through a temporary file and a rename, so that readers never see it half written.
+// The Prometheus text format is used for files ending in .prom, JSON otherwise.
+class ProgressMetrics
+{
+public:
+    ProgressMetrics(const std::string& file, const double& interval);
+    // Stops the timer, and writes the file a last time
+    ~ProgressMetrics();
+
+    static ProgressMetrics* Instance();
+
+    // nEvents to be simulated by this run, starting the rates and the ETA
+    void BeginOfRun(const long& nEvents);
+    void EndOfRun();
+
+    void EndOfEvent(const long& nSteps, const long& bytesWritten)
+    {
+        fEvents.fetch_add(1, std::memory_order_relaxed);
+        fSteps.fetch_add(nSteps, std::memory_order_relaxed);
+        fBytes.store(bytesWritten, std::memory_order_relaxed);
+    }
+
+private:
+    void Loop();
+    void Write();
+
+    static ProgressMetrics* fgInstance;
+
+    std::string fFile;
+    double fInterval;    // s
+    std::atomic<long> fEvents;
+    std::atomic<long> fSteps;
+    std::atomic<long> fBytes;
+    std::atomic<long> fTarget;
+    std::atomic<double> fRunStart;    // Wall time in s, negative outside the run
+    std::atomic<int> fState;    // 0: initialising, 1: running, 2: done
+    double fJobStart;
+    bool fStop;
+    std::mutex fMutex;
+    std::condition_variable fWake;
+    std::thread fThread;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef ResourceUsage_h
+#define ResourceUsage_h 1
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Clocks and memory of the running process, for the performance reports
+class ResourceUsage
+{
+public:
+    // Monotonic wall-clock time in s
+    static double WallTime()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // CPU time of the calling thread in s
+    static double CpuTime()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec + 1e-9 * ts.tv_nsec;
+    }
+
+    // Resident memory in MB, now and at its peak
+    static double RSS()
+    {
+        long pages = 0, resident = 0;
+        FILE* statm = std::fopen("/proc/self/statm", "r");
+        if (!statm)
+            return 0.0;
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        std::fclose(statm);
+        return resident * (sysconf(_SC_PAGESIZE) / 1048576.0);
+    }
+
+    static double PeakRSS()
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024.0;
+    }
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "globals.hh"
 #include "Config.hh"
 #include <map>
+#include <vector>
 
 class G4Run;
 class HistoManager;
@@ -24,6 +25,10 @@ public:
     void Balance(G4double,G4double);
     void EventTiming(G4double);
     void PrimaryTiming(G4double);
+    void EnergyBalance(const G4double& primary, const G4double& active, const G4double& passive, const G4double& local, const G4int& nLocal, const G4int& nRoulette);
+    void BudgetCount(const G4int& nKilledTracks, const G4bool& aborted);
+    // Wall and CPU time in s, steps and cells of an event; true if its wall time is above Profile/slow_percentile of the earlier events
+    G4bool EventLatency(const G4double& wall, const G4double& cpu, const G4long& nSteps, const G4int& nCells);
     
 private:
     PrimaryGeneratorAction* fPrimary;
@@ -39,6 +44,20 @@ private:
     G4double fPbalance[3];
     G4double fEventTime[3];
     G4double fPrimaryTime;                        
+    G4double fEnergyBalance[4];    // Primary, active, passive, local
+    G4long   fNLocal;
+    G4long   fNRoulette;
+    G4long   fNKilledTracks;
+    G4int    fNAborted;
+    // Wall time per event, log-binned from 1 us to 10^4 s with 20 bins per decade
+    std::vector<G4long> fLatency;
+    G4long   fNLatency;
+    G4double fLatencyMax;
+    G4double fLatencySum[2];    // Wall, CPU
+    G4long   fStepSum;
+    G4long   fCellSum;
+    G4double fSlowPercentile;
+    G4double LatencyQuantile(const G4double& q) const;
 //    G4double fPrimaryEnergy;                        
 };
 
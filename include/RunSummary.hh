@@ -0,0 +1,78 @@
+#ifndef RunSummary_h
+#define RunSummary_h 1
+
+#include "ResourceUsage.hh"
+#include "PerfCounters.hh"
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Wall time, CPU time and resident memory of the phases of a job, and scalar results of the run,
+// printed as a table and written as JSON. Phases may nest, e.g. the geometry within the initialisation.
+class RunSummary
+{
+public:
+    // Times the phase from its construction to the end of the scope
+    class Scope
+    {
+    public:
+        Scope(RunSummary& summary, const std::string& phase) : fSummary(summary), fPhase(phase)
+        {
+            fSummary.Start(fPhase);
+        }
+
+        ~Scope()
+        {
+            fSummary.Stop(fPhase);
+        }
+
+    private:
+        RunSummary& fSummary;
+        std::string fPhase;
+    };
+
+    RunSummary() : fDepth(0), fPeakRss(0.0), fCounters(0) {}
+
+    // Hardware counters of the phases started from now on, none if 0
+    void SetCounters(PerfCounters* counters)
+    {
+        fCounters = counters;
+    }
+
+    // Phases spanning several functions; a phase started again is listed again
+    void Start(const std::string& phase);
+    void Stop(const std::string& phase);
+
+    // A scalar of the run, e.g. the number of events; a key set again is overwritten
+    void Set(const std::string& key, const double& value);
+
+    // Wall time in s of the last phase of this name, 0 if it was never completed
+    double GetWallTime(const std::string& phase) const;
+
+    void Print(std::ostream& out) const;
+    bool Write(const std::string& file) const;
+
+private:
+    class Phase
+    {
+    public:
+        std::string fName;
+        int    fDepth = 0;
+        bool   fDone = false;
+        double fWall = 0.0;    // s
+        double fCpu = 0.0;     // s
+        double fRssStart = 0.0;    // MB
+        double fRss = 0.0;
+        bool   fCounted = false;
+        PerfCounters::Sample fCounts;
+    };
+
+    std::vector<Phase> fPhases;
+    std::vector<std::pair<std::string, double>> fValues;
+    int fDepth;
+    double fPeakRss;
+    PerfCounters* fCounters;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef ShowerLibrary_h
+#define ShowerLibrary_h 1
+
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+class Config;
+class G4Region;
+class G4LogicalVolume;
+class G4ParticleDefinition;
+class G4Step;
+class G4Track;
+class TFile;
+class TTree;
+
+// Energy deposited in one scintillator cell, relative to the start and direction of the particle
+class FrozenSpot
+{
+public:
+    G4float fL;     // Along the direction
+    G4float fT1;    // Transverse
+    G4float fT2;
+    G4float fE;
+};
+
+// Deposits of the full EM sub-shower of one e+/e-/gamma in the HCAL
+class FrozenShower
+{
+public:
+    G4double fEnergy;
+    std::vector<FrozenSpot> fSpots;
+};
+
+// Library of frozen EM showers in the HCAL, binned in particle type, energy (logarithmic) and starting position within a layer.
+// In generation mode the showers of all e+/e-/gamma in [emin, emax] are recorded into a ROOT file;
+// with a library file, FrozenShowerModel replaces these particles by showers drawn from it.
+class ShowerLibrary
+{
+public:
+    ShowerLibrary(Config* c);
+    ~ShowerLibrary();
+
+    static ShowerLibrary* Instance();
+
+    void SetGeometry(G4Region* region, G4LogicalVolume* active, const G4double& front, const G4double& thickness)
+    {
+        fRegion = region;
+        fActive = active;
+        fFront = front;
+        fThickness = thickness;
+    }
+
+    G4Region* GetRegion() const
+    {
+        return fRegion;
+    }
+
+    G4LogicalVolume* GetActive() const
+    {
+        return fActive;
+    }
+
+    G4bool IsGenerating() const
+    {
+        return !fGenerate.empty();
+    }
+
+    G4bool IsLoaded() const
+    {
+        return !fShowers.empty();
+    }
+
+    // Bin of a particle; false if it is not an e+/e-/gamma within the energy range of the library
+    G4bool GetBin(const G4ParticleDefinition* particle, const G4double& energy, const G4double& z, std::tuple<G4int, G4int, G4int>& bin) const;
+    // Whether the bin has any shower; draws no random number
+    G4bool HasShowers(const std::tuple<G4int, G4int, G4int>& bin) const
+    {
+        auto it = fShowers.find(bin);
+        return it != fShowers.end() && !it->second.empty();
+    }
+    // A random shower of the bin, or nullptr if the bin is empty
+    const FrozenShower* Draw(const std::tuple<G4int, G4int, G4int>& bin) const;
+
+    // Generation mode
+    void Open();
+    void BeginTrack(const G4Track* track);
+    void AddStep(const G4Step* step, const G4int& copyNo, const G4double& edep);
+    void EndOfEvent();
+    void Close();
+
+private:
+    void Load(const G4String& fname);
+
+    static ShowerLibrary* fgInstance;
+
+    G4String fGenerate;
+    G4double fEmin;
+    G4double fEmax;
+    G4int    fNEnergyBins;
+    G4int    fNPositionBins;
+
+    G4Region*        fRegion;
+    G4LogicalVolume* fActive;
+    G4double         fFront;
+    G4double         fThickness;
+
+    std::map<std::tuple<G4int, G4int, G4int>, std::vector<FrozenShower>> fShowers;
+
+    // Showers being recorded in the current event, and the shower each track belongs to
+    class Root
+    {
+    public:
+        std::tuple<G4int, G4int, G4int> fBin;
+        G4ThreeVector fPosition, fDirection, fT1, fT2;
+        G4double fEnergy;
+        std::unordered_map<G4int, FrozenSpot> fCells;
+    };
+    std::vector<Root> fRoots;
+    std::unordered_map<G4int, G4int> fRootOf;
+
+    TFile* fFile;
+    TTree* fTree;
+    G4int  fType, fEnergyBin, fPositionBin;
+    G4double fEnergy;
+    std::vector<G4float> fL, fT1, fT2, fE;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef StackingAction_h
+#define StackingAction_h 1
+
+#include "G4UserStackingAction.hh"
+#include "globals.hh"
+#include "Config.hh"
+#include <unordered_map>
+
+class EventAction;
+class G4LogicalVolume;
+class G4Navigator;
+class G4EmCalculator;
+class Config;
+
+// Local-deposition approximation: e+/e-/gamma created in passive volumes, which would not reach an active layer,
+// are killed at creation and their energy is booked as local deposit.
+// Also plays Russian roulette with slow neutrons, whose survivors get a larger weight.
+class StackingAction : public G4UserStackingAction
+{
+public:
+    StackingAction(EventAction*, Config* c);
+    ~StackingAction();
+
+    virtual G4ClassificationOfNewTrack ClassifyNewTrack(const G4Track*);
+
+private:
+    // Thresholds of one passive volume
+    class Rule
+    {
+    public:
+        G4double fEcut;     // e+/e-/gamma below this kinetic energy
+        G4bool   fRange;    // Electrons whose range is shorter than the distance to the volume boundary
+    };
+
+    void SetUpRules();
+
+    EventAction*    fEventAction;
+    Config*         config;
+    G4bool          fEnabled;
+    G4double        fRouletteEmax;
+    G4double        fRouletteSurvival;
+    G4Navigator*    fNavigator;
+    G4EmCalculator* fCalculator;
+    std::unordered_map<const G4LogicalVolume*, Rule> fRules;
+};
+
+#endif
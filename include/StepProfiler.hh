@@ -0,0 +1,123 @@
+#ifndef StepProfiler_h
+#define StepProfiler_h 1
+
+#include "globals.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VProcess.hh"
+#include "G4AutoLock.hh"
+#include "ResourceUsage.hh"
+#include <unordered_map>
+#include <vector>
+
+class Config;
+
+// Steps, tracks and sampled CPU time by logical volume, particle and limiting process, with Profile/steps.
+// Each thread counts into its own tables, indexed by the instance IDs of the volumes and particles;
+// the tables are merged, printed and written as JSON at the end of the run.
+class StepProfiler
+{
+public:
+    StepProfiler(Config* c);
+    ~StepProfiler();
+
+    static StepProfiler* Instance();
+
+    void BeginOfRun();
+    void EndOfRun();
+
+    // One step; the CPU time since the previous step is measured on one step in fSample, and counts fSample times
+    void Step(const G4Step* step)
+    {
+        Table& table = GetTable();
+        G4double time = 0.0;
+        G4long n = ++table.fNSteps % fSample;
+        if (n == 0 && table.fLastTime >= 0.0)
+            time = fSample * (ResourceUsage::CpuTime() - table.fLastTime);
+
+        G4LogicalVolume* volume = step->GetPreStepPoint()->GetPhysicalVolume()->GetLogicalVolume();
+        Count(table.fVolumes, volume->GetInstanceID(), volume->GetName(), 1, 0, time);
+        const G4ParticleDefinition* particle = step->GetTrack()->GetDefinition();
+        Count(table.fParticles, particle->GetInstanceID(), particle->GetParticleName(), 1, 0, time);
+        const G4VProcess* process = step->GetPostStepPoint()->GetProcessDefinedStep();
+        Counter& counter = table.fProcesses[process];
+        if (counter.fSteps == 0 && counter.fTracks == 0)
+            counter.fName = process ? process->GetProcessName() : "none";
+        counter.fSteps++;
+        counter.fTime += time;
+
+        if (n == fSample - 1)
+            table.fLastTime = ResourceUsage::CpuTime();
+    }
+
+    // One new track, counted in its particle, the volume where it starts and its creator process
+    void Track(const G4Track* track)
+    {
+        Table& table = GetTable();
+        if (track->GetVolume())
+        {
+            G4LogicalVolume* volume = track->GetVolume()->GetLogicalVolume();
+            Count(table.fVolumes, volume->GetInstanceID(), volume->GetName(), 0, 1, 0.0);
+        }
+        Count(table.fParticles, track->GetDefinition()->GetInstanceID(), track->GetDefinition()->GetParticleName(), 0, 1, 0.0);
+        const G4VProcess* process = track->GetCreatorProcess();
+        Counter& counter = table.fCreators[process];
+        if (counter.fTracks == 0)
+            counter.fName = process ? process->GetProcessName() : "primary";
+        counter.fTracks++;
+    }
+
+private:
+    class Counter
+    {
+    public:
+        G4String fName;
+        G4long   fSteps = 0;
+        G4long   fTracks = 0;
+        G4double fTime = 0.0;    // In s
+    };
+
+    class Table
+    {
+    public:
+        std::vector<Counter> fVolumes;
+        std::vector<Counter> fParticles;
+        std::unordered_map<const G4VProcess*, Counter> fProcesses;
+        std::unordered_map<const G4VProcess*, Counter> fCreators;
+        G4long   fNSteps = 0;
+        G4double fLastTime = -1.0;    // Thread CPU time before the next sampled step, negative if not taken yet
+    };
+
+    static void Count(std::vector<Counter>& counters, const G4int& index, const G4String& name, const G4long& steps, const G4long& tracks, const G4double& time)
+    {
+        if (index >= static_cast<G4int>(counters.size()))
+            counters.resize(index + 1);
+        Counter& counter = counters[index];
+        if (counter.fSteps == 0 && counter.fTracks == 0)
+            counter.fName = name;
+        counter.fSteps += steps;
+        counter.fTracks += tracks;
+        counter.fTime += time;
+    }
+
+    Table& GetTable()
+    {
+        if (!fgTable)
+            Register();
+        return *fgTable;
+    }
+
+    void Register();
+
+    static StepProfiler* fgInstance;
+    static G4ThreadLocal Table* fgTable;
+
+    G4long   fSample;
+    G4String fOutput;
+    G4int    fNReport;
+    std::vector<Table*> fTables;
+    G4Mutex  fMutex;
+};
+
+#endif
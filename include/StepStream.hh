@@ -0,0 +1,49 @@
+#ifndef StepStream_h
+#define StepStream_h 1
+
+#include "CellID.hh"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Deposits of the active volumes as booked into the readout, recorded by calo with Profile/record_steps
+// and replayed by calo-readout-bench. Binary file of (subdetector, copy number, edep in MeV) records,
+// with a record of subdetector kNone after each event.
+class StepStream
+{
+public:
+    class Step
+    {
+    public:
+        std::int32_t fSubdetector;
+        std::int32_t fCopyNo;
+        double       fEdep;
+    };
+
+    // Record into file
+    StepStream(const std::string& file);
+    ~StepStream();
+
+    static StepStream* Instance();
+
+    void Write(const int& subdetector, const int& copyNo, const double& edep)
+    {
+        Step step = {subdetector, copyNo, edep};
+        fOut.write(reinterpret_cast<const char*>(&step), sizeof(step));
+    }
+
+    void EndOfEvent()
+    {
+        Write(CellID::kNone, 0, 0.0);
+    }
+
+    // Events of a recorded file; false if it cannot be read
+    static bool Read(const std::string& file, std::vector<std::vector<Step>>& events);
+
+private:
+    static StepStream* fgInstance;
+    std::ofstream fOut;
+};
+
+#endif
@@ -10,11 +10,13 @@ class DetectorConstruction;
 class EventAction;
 class G4LogicalVolume;
 class HistoManager;
+class Config;
+class StepProfiler;
 
 class SteppingAction : public G4UserSteppingAction
 {
 public:
-    SteppingAction(DetectorConstruction*, EventAction*);
+    SteppingAction(DetectorConstruction*, EventAction*, Config* c);
     //SteppingAction();
     virtual ~SteppingAction();
   
@@ -36,6 +38,12 @@ public:
         return fVolume;
     }
 
+    // Steps since the start of the job
+    G4long GetStepCount() const
+    {
+        return fStepCounter;
+    }
+
     //G4double GetEnergy() const { return fEnergy;}
     double preEnergy;
 
@@ -49,6 +57,14 @@ private:
     G4double kineticEn;
     G4String volume1;
     G4String volume2;
+
+    // Budgets against looping and runaway tracks, and against events which stall the job (0: no limit)
+    G4int    fMaxSteps;
+    G4double fMaxTime;
+    G4double fMaxWall;
+    G4long   fStepCounter;
+    // Null unless Profile/steps is set
+    StepProfiler* fProfiler;
 //    G4double fEnergy; 
 };
 
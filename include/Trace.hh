@@ -0,0 +1,105 @@
+#ifndef Trace_h
+#define Trace_h 1
+
+// Timeline of begin/end spans, written in the Chrome trace-event format for chrome://tracing or Perfetto.
+// Only built with -DWITH_TRACE=ON; otherwise the macros below expand to nothing, and their arguments are not evaluated.
+// Each thread records into its own ring buffer, which keeps the latest spans when it is full.
+#ifdef CALO_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Trace
+{
+public:
+    // Span names are kept as pointers: string literals, or strings from Intern
+    static void Begin(const char* name)
+    {
+        Record(name, 'B');
+    }
+
+    static void End(const char* name)
+    {
+        Record(name, 'E');
+    }
+
+    // A copy of the name which lives until the end of the job, for names built at run time
+    static const char* Intern(const std::string& name);
+
+    // All threads, in one file; false if it could not be written
+    static bool Write(const std::string& file);
+
+    class Scope
+    {
+    public:
+        Scope(const char* name) : fName(name)
+        {
+            Begin(fName);
+        }
+
+        ~Scope()
+        {
+            End(fName);
+        }
+
+    private:
+        const char* fName;
+    };
+
+    // One begin or end
+    class Event
+    {
+    public:
+        const char*   fName;
+        std::int64_t  fTime;    // ns since the start of the job
+        char          fPhase;
+    };
+
+    // Ring buffer of one thread
+    class Buffer
+    {
+    public:
+        std::vector<Event> fEvents;
+        std::size_t fNext = 0;
+        bool fWrapped = false;
+        int  fThread = 0;
+    };
+
+private:
+    static void Record(const char* name, const char& phase)
+    {
+        Buffer& buffer = fgBuffer ? *fgBuffer : Register();
+        Event& event = buffer.fEvents[buffer.fNext];
+        event.fName = name;
+        event.fTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - fgStart).count();
+        event.fPhase = phase;
+        if (++buffer.fNext == buffer.fEvents.size())
+        {
+            buffer.fNext = 0;
+            buffer.fWrapped = true;
+        }
+    }
+
+    static Buffer& Register();
+
+    static thread_local Buffer* fgBuffer;
+    static const std::chrono::steady_clock::time_point fgStart;
+};
+
+#define CALO_TRACE_CONCAT_(a, b) a##b
+#define CALO_TRACE_CONCAT(a, b) CALO_TRACE_CONCAT_(a, b)
+#define CALO_TRACE_SCOPE(name) Trace::Scope CALO_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define CALO_TRACE_BEGIN(name) Trace::Begin(name)
+#define CALO_TRACE_END(name) Trace::End(name)
+
+#else
+
+#define CALO_TRACE_SCOPE(name)
+#define CALO_TRACE_BEGIN(name)
+#define CALO_TRACE_END(name)
+
+#endif
+
+#endif
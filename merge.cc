@@ -0,0 +1,242 @@
+#include "TFile.h"
+#include "TTree.h"
+#include "TChain.h"
+#include "TBranch.h"
+#include "TObjArray.h"
+#include "TROOT.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One entry of the RunInfo tree written by HistoManager
+struct RunRecord
+{
+    ULong64_t fConfigHash;
+    Long64_t  fSeed;
+    Int_t     fShard;
+    Long64_t  fFirstEvent;
+    Long64_t  fNEvents;
+    Long64_t  fNEntries;
+    Long64_t  fEntryOffset;
+};
+
+// Everything needed to decide whether an input may be merged, read before any event is copied
+struct InputManifest
+{
+    std::string fName;
+    std::string fSchema;
+    std::string fError;
+    Long64_t    fEntries = 0;
+    std::vector<RunRecord> fRuns;
+};
+
+void Inspect(InputManifest& input)
+{
+    std::unique_ptr<TFile> file(TFile::Open(input.fName.c_str(), "READ"));
+    if (!file || file->IsZombie())
+    {
+        input.fError = "cannot be opened";
+        return;
+    }
+
+    TTree* hits = nullptr;
+    file->GetObject("Calib_Hit", hits);
+    if (!hits)
+    {
+        input.fError = "has no Calib_Hit tree";
+        return;
+    }
+    input.fEntries = hits->GetEntries();
+
+    // Branch names and types; fast cloning requires them to be identical in all inputs
+    TObjArray* branches = hits->GetListOfBranches();
+    for (Int_t i = 0; i < branches->GetEntriesFast(); i++)
+    {
+        TBranch* branch = static_cast<TBranch*>(branches->At(i));
+        std::string type = branch->GetClassName();
+        if (type.empty())
+            type = branch->GetTitle();
+        input.fSchema += std::string(branch->GetName()) + "=" + type + ";";
+    }
+
+    TTree* runs = nullptr;
+    file->GetObject("RunInfo", runs);
+    if (!runs)
+    {
+        input.fError = "has no RunInfo tree, so its configuration cannot be verified";
+        return;
+    }
+
+    RunRecord record;
+    runs->SetBranchAddress("ConfigHash",  &record.fConfigHash);
+    runs->SetBranchAddress("Seed",        &record.fSeed);
+    runs->SetBranchAddress("Shard",       &record.fShard);
+    runs->SetBranchAddress("FirstEvent",  &record.fFirstEvent);
+    runs->SetBranchAddress("NEvents",     &record.fNEvents);
+    runs->SetBranchAddress("EntryOffset", &record.fEntryOffset);
+    // Files written before NEntries kept the entry count in NEvents
+    bool hasEntries = (runs->GetBranch("NEntries") != nullptr);
+    if (hasEntries)
+        runs->SetBranchAddress("NEntries", &record.fNEntries);
+
+    Long64_t nRecorded = 0;
+    for (Long64_t i = 0; i < runs->GetEntries(); i++)
+    {
+        runs->GetEntry(i);
+        if (!hasEntries)
+            record.fNEntries = record.fNEvents;
+        input.fRuns.emplace_back(record);
+        nRecorded += record.fNEntries;
+    }
+    runs->ResetBranchAddresses();
+
+    if (input.fRuns.empty())
+        input.fError = "has an empty RunInfo tree";
+    else if (nRecorded != input.fEntries)
+        input.fError = "records " + std::to_string(nRecorded) + " entries in RunInfo but holds " + std::to_string(input.fEntries);
+}
+
+int main(int argc, char** argv)
+{
+    std::string output;
+    std::vector<std::string> inputs;
+    unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == std::string("-h") || std::string(argv[i]) == std::string("-help"))
+        {
+            std::cout << std::endl;
+            std::cout << "Help information" << std::endl << std::endl;
+            std::cout << "Merge calo outputs:   calo-merge -o [output] [input1] [input2] ..." << std::endl;
+            std::cout << "Number of threads:    calo-merge -j [n] ...    (default: all cores)" << std::endl << std::endl;
+            std::cout << "Inputs must have the same branches and configuration hash; events are copied without recompression." << std::endl << std::endl;
+            return 1;
+        }
+
+        else if (std::string(argv[i]) == std::string("-o") && i + 1 < argc)
+            output = argv[++i];
+
+        else if (std::string(argv[i]) == std::string("-j") && i + 1 < argc)
+            nThreads = std::max(1, std::stoi(argv[++i]));
+
+        else
+            inputs.emplace_back(argv[i]);
+    }
+
+    if (output.empty() || inputs.empty())
+    {
+        std::cout << "No output or input files given! Execute \"calo-merge -h[elp]\" to display help message." << std::endl;
+        return 1;
+    }
+
+    // Read the manifests of all inputs in parallel
+    ROOT::EnableThreadSafety();
+    std::vector<InputManifest> manifests(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++)
+        manifests.at(i).fName = inputs.at(i);
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < std::min<size_t>(nThreads, inputs.size()); t++)
+        workers.emplace_back([&]()
+        {
+            for (size_t i = next++; i < manifests.size(); i = next++)
+                Inspect(manifests.at(i));
+        });
+    for (auto& worker : workers)
+        worker.join();
+
+    // Verify that all inputs are compatible with the first one
+    int nBad = 0;
+    const InputManifest& reference = manifests.front();
+    for (const auto& input : manifests)
+    {
+        std::string problem = input.fError;
+        if (problem.empty() && input.fSchema != reference.fSchema)
+            problem = "has different branches from " + reference.fName;
+        if (problem.empty() && !reference.fRuns.empty())
+            for (const auto& run : input.fRuns)
+                if (run.fConfigHash != reference.fRuns.front().fConfigHash)
+                    problem = "was produced with a different configuration from " + reference.fName;
+
+        if (!problem.empty())
+        {
+            std::cout << "Input " << input.fName << " " << problem << "!" << std::endl;
+            nBad++;
+        }
+    }
+    if (nBad > 0)
+    {
+        std::cout << nBad << " incompatible input(s), nothing merged." << std::endl;
+        return 1;
+    }
+
+    // Copy the compressed baskets of Calib_Hit into the output
+    std::unique_ptr<TFile> fout(TFile::Open(output.c_str(), "RECREATE"));
+    if (!fout || fout->IsZombie())
+    {
+        std::cout << "Output " << output << " cannot be created!" << std::endl;
+        return 1;
+    }
+
+    TChain chain("Calib_Hit");
+    for (const auto& input : manifests)
+        chain.Add(input.fName.c_str());
+    // Returns the number of files written, 0 on failure
+    if (chain.Merge(fout.get(), 0, "fast keep") == 0)
+    {
+        std::cout << "Merging into " << output << " failed!" << std::endl;
+        return 1;
+    }
+
+    // Keep the provenance of every run, with entry offsets pointing into the merged tree
+    fout->cd();
+    RunRecord record;
+    TTree* runTree = new TTree("RunInfo", "Run provenance");
+    runTree->Branch("ConfigHash",  &record.fConfigHash,  "ConfigHash/l");
+    runTree->Branch("Seed",        &record.fSeed,        "Seed/L");
+    runTree->Branch("Shard",       &record.fShard,       "Shard/I");
+    runTree->Branch("FirstEvent",  &record.fFirstEvent,  "FirstEvent/L");
+    runTree->Branch("NEvents",     &record.fNEvents,     "NEvents/L");
+    runTree->Branch("NEntries",    &record.fNEntries,    "NEntries/L");
+    runTree->Branch("EntryOffset", &record.fEntryOffset, "EntryOffset/L");
+
+    Long64_t offset = 0;
+    Long64_t nEvents = 0;
+    for (const auto& input : manifests)
+    {
+        for (const auto& run : input.fRuns)
+        {
+            record = run;
+            nEvents += run.fNEvents;
+            record.fEntryOffset += offset;
+            runTree->Fill();
+        }
+        offset += input.fEntries;
+    }
+    runTree->Write("", TObject::kOverwrite);
+
+    // The geometry is the same in all inputs, so the first copy is kept
+    std::unique_ptr<TFile> first(TFile::Open(reference.fName.c_str(), "READ"));
+    if (TObject* geometry = first->Get("cepc_calo"))
+    {
+        fout->cd();
+        geometry->Write("cepc_calo");
+    }
+
+    Long64_t nRuns = runTree->GetEntries();
+    fout->Close();
+
+    std::cout << "Merged " << nEvents << " events (" << offset << " entries) of " << manifests.size() << " file(s), "
+              << nRuns << " run(s), configuration hash "
+              << std::hex << std::setw(16) << std::setfill('0') << reference.fRuns.front().fConfigHash << std::dec
+              << ", into " << output << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+#include "Digitizer.hh"
+#include "TFile.h"
+#include "TTree.h"
+#include "TRandom3.h"
+#include "TROOT.h"
+#include "yaml-cpp/yaml.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Cell deposits of one entry of a calo output, before digitisation
+struct RawEvent
+{
+    Long64_t               fEventID;
+    std::vector<ULong64_t> fCellID;
+    std::vector<double>    fEnergy;
+};
+
+// One input sample, shifted by whole cells, read entry by entry
+struct Input
+{
+    std::string            fName;
+    int                    fDX = 0;
+    int                    fDY = 0;
+    std::unique_ptr<TFile> fFile;
+    TTree*                 fTree = nullptr;
+    Long64_t               fEntries = 0;
+    Long64_t               fEventID = 0;
+    std::vector<ULong64_t>* fCellID = nullptr;
+    std::vector<double>*   fEnergy = nullptr;
+};
+
+// One overlaid event, ready to be written
+struct Overlay
+{
+    std::vector<ULong64_t> fCellID;
+    std::vector<double>    fEnergy, fX, fY, fZ;
+    std::vector<ULong64_t> fRawCellID;
+    std::vector<double>    fRawEnergy;
+    std::vector<int>       fSourceFile;
+    std::vector<Long64_t>  fSourceEvent;
+};
+
+// Open the input and attach its branches; the events are read when they are needed
+bool Open(Input& input)
+{
+    input.fFile.reset(TFile::Open(input.fName.c_str(), "READ"));
+    if (input.fFile && !input.fFile->IsZombie())
+        input.fFile->GetObject("Calib_Hit", input.fTree);
+    TTree* tree = input.fTree;
+    if (!tree || !tree->GetBranch("Raw_CellID") || !tree->GetBranch("Raw_Energy"))
+    {
+        std::cout << "Input " << input.fName << " has no Raw_CellID/Raw_Energy branches; produce it with saveraw: true!" << std::endl;
+        return false;
+    }
+
+    if (tree->GetBranch("EventID"))
+        tree->SetBranchAddress("EventID", &input.fEventID);
+    if (tree->SetBranchAddress("Raw_CellID", &input.fCellID) < 0 || tree->SetBranchAddress("Raw_Energy", &input.fEnergy) < 0)
+    {
+        std::cout << "Input " << input.fName << " has 32-bit cell IDs; produce it again with this version of calo!" << std::endl;
+        return false;
+    }
+    input.fEntries = tree->GetEntries();
+    std::cout << "Input " << input.fName << ": " << input.fEntries << " events, shifted by (" << input.fDX << ", " << input.fDY << ") cells" << std::endl;
+    return true;
+}
+
+void Read(Input& input, const Long64_t& entry, RawEvent& raw)
+{
+    input.fEventID = entry;
+    input.fTree->GetEntry(entry);
+    raw = RawEvent{input.fEventID, *input.fCellID, *input.fEnergy};
+}
+
+// Independent random stream for each output event
+std::uint64_t EventSeed(const std::uint64_t& seed, const Long64_t& event)
+{
+    std::uint64_t x = seed ^ (0x9E3779B97F4A7C15ULL * (static_cast<std::uint64_t>(event) + 1));
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Events of the inputs used by one chunk, by (input, entry)
+typedef std::map<std::pair<int, Long64_t>, RawEvent> EventCache;
+
+// Inputs and entries summed into an output event: the same entry of every input without pileup, otherwise the signal
+// and a Poisson number of random pileup events, drawn from random
+std::vector<std::pair<int, Long64_t>> Sources(const std::vector<Input>& inputs, const Long64_t& event, const double& pileup,
+                                              const int& firstPileup, const Long64_t& nPool, TRandom3& random)
+{
+    std::vector<std::pair<int, Long64_t>> sources;
+    if (pileup < 0.0)
+    {
+        for (size_t i = 0; i < inputs.size(); i++)
+            sources.emplace_back(i, event);
+        return sources;
+    }
+    sources.emplace_back(0, event);
+    int n = (nPool > 0) ? random.Poisson(pileup) : 0;
+    for (int p = 0; p < n; p++)
+    {
+        // Uniform over all pileup events; the signal itself is not drawn
+        Long64_t pick = static_cast<Long64_t>(random.Integer(nPool));
+        size_t file = firstPileup;
+        while (pick >= inputs.at(file).fEntries)
+            pick -= inputs.at(file++).fEntries;
+        if (file == 0 && pick == event)
+            continue;
+        sources.emplace_back(file, pick);
+    }
+    return sources;
+}
+
+void Add(const Digitizer& digitizer, const Input& input, const int& file, const RawEvent& raw,
+         std::unordered_map<ULong64_t, double>& cells, Overlay& overlay)
+{
+    for (size_t j = 0; j < raw.fCellID.size(); j++)
+    {
+        ULong64_t cellID = digitizer.Shift(raw.fCellID.at(j), input.fDX, input.fDY);
+        if (cellID != CellID::kInvalid)
+            cells[cellID] += raw.fEnergy.at(j);
+    }
+    overlay.fSourceFile.emplace_back(file);
+    overlay.fSourceEvent.emplace_back(raw.fEventID);
+}
+
+int main(int argc, char** argv)
+{
+    std::string output, config;
+    std::vector<Input> inputs;
+    Long64_t nEvents = -1;
+    double pileup = -1.0;
+    std::uint64_t seed = 2022;
+    unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+    int dx = 0, dy = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == std::string("-h") || std::string(argv[i]) == std::string("-help"))
+        {
+            std::cout << std::endl;
+            std::cout << "Help information" << std::endl << std::endl;
+            std::cout << "Overlay samples:      calo-overlay -c [yaml] -o [output] [input1] -s [dx] [dy] [input2] ..." << std::endl;
+            std::cout << "Pileup:               calo-overlay -c [yaml] -o [output] --pileup [mean] [signal] [pileup1] ..." << std::endl;
+            std::cout << "Number of events:     calo-overlay -n [n] ...     (default: all)" << std::endl;
+            std::cout << "Random seed:          calo-overlay --seed [n] ... (default: 2022)" << std::endl;
+            std::cout << "Number of threads:    calo-overlay -j [n] ...     (default: all cores)" << std::endl << std::endl;
+            std::cout << "Inputs must be written with saveraw: true. -s shifts the following inputs by whole cells." << std::endl;
+            std::cout << "Without --pileup, event i of all inputs are summed; with it, event i of the first input gets" << std::endl;
+            std::cout << "a Poisson number of random events from the other inputs (or from the first one, if alone)." << std::endl;
+            std::cout << "The ECAL and HCAL sections of the YAML file define the cells and their digitisation;" << std::endl;
+            std::cout << "ECAL strips cannot be shifted by HCAL cells, and are dropped from shifted inputs." << std::endl << std::endl;
+            return 1;
+        }
+
+        else if (std::string(argv[i]) == std::string("-o") && i + 1 < argc)
+            output = argv[++i];
+
+        else if (std::string(argv[i]) == std::string("-c") && i + 1 < argc)
+            config = argv[++i];
+
+        else if (std::string(argv[i]) == std::string("-n") && i + 1 < argc)
+            nEvents = std::stoll(argv[++i]);
+
+        else if (std::string(argv[i]) == std::string("-j") && i + 1 < argc)
+            nThreads = std::max(1, std::stoi(argv[++i]));
+
+        else if (std::string(argv[i]) == std::string("-s") && i + 2 < argc)
+        {
+            dx = std::stoi(argv[++i]);
+            dy = std::stoi(argv[++i]);
+        }
+
+        else if (std::string(argv[i]) == std::string("--pileup") && i + 1 < argc)
+            pileup = std::stod(argv[++i]);
+
+        else if (std::string(argv[i]) == std::string("--seed") && i + 1 < argc)
+            seed = std::stoull(argv[++i]);
+
+        else
+        {
+            inputs.emplace_back();
+            inputs.back().fName = argv[i];
+            inputs.back().fDX = dx;
+            inputs.back().fDY = dy;
+        }
+    }
+
+    if (output.empty() || config.empty() || inputs.empty())
+    {
+        std::cout << "No output, YAML or input files given! Execute \"calo-overlay -h[elp]\" to display help message." << std::endl;
+        return 1;
+    }
+
+    const Digitizer digitizer(YAML::LoadFile(config));
+
+    for (auto& input : inputs)
+        if (!Open(input))
+            return 1;
+
+    // Without pileup all inputs are read in step, otherwise the first input is the signal
+    Long64_t nAvailable = inputs.front().fEntries;
+    if (pileup < 0.0)
+        for (const auto& input : inputs)
+            nAvailable = std::min(nAvailable, input.fEntries);
+    nEvents = (nEvents < 0) ? nAvailable : std::min(nEvents, nAvailable);
+    int firstPileup = (inputs.size() > 1) ? 1 : 0;
+    Long64_t nPool = 0;
+    for (size_t i = firstPileup; i < inputs.size(); i++)
+        nPool += inputs.at(i).fEntries;
+
+    std::unique_ptr<TFile> fout(TFile::Open(output.c_str(), "RECREATE"));
+    if (!fout || fout->IsZombie())
+    {
+        std::cout << "Output " << output << " cannot be created!" << std::endl;
+        return 1;
+    }
+    Long64_t eventID = 0;
+    Overlay row;
+    TTree* tree = new TTree("Calib_Hit", "Overlaid events");
+    tree->Branch("EventID",         &eventID, "EventID/L");
+    tree->Branch("CellID",          &row.fCellID);
+    tree->Branch("Hit_Energy",      &row.fEnergy);
+    tree->Branch("Hit_X",           &row.fX);
+    tree->Branch("Hit_Y",           &row.fY);
+    tree->Branch("Hit_Z",           &row.fZ);
+    tree->Branch("Raw_CellID",      &row.fRawCellID);
+    tree->Branch("Raw_Energy",      &row.fRawEnergy);
+    tree->Branch("Overlay_File",    &row.fSourceFile);
+    tree->Branch("Overlay_EventID", &row.fSourceEvent);
+
+    // Overlays are built in parallel, chunk by chunk, and written in order. Only the events used by the chunk are read,
+    // in order of input and entry; the sources are drawn here and again by the workers, from the same seeds
+    const Long64_t chunkSize = 10000;
+    std::vector<Overlay> chunk;
+    EventCache cache;
+    for (Long64_t first = 0; first < nEvents; first += chunkSize)
+    {
+        Long64_t nChunk = std::min(chunkSize, nEvents - first);
+        cache.clear();
+        for (Long64_t event = first; event < first + nChunk; event++)
+        {
+            TRandom3 random(EventSeed(seed, event) | 1);
+            for (const auto& source : Sources(inputs, event, pileup, firstPileup, nPool, random))
+                cache[source];
+        }
+        for (auto& entry : cache)
+            Read(inputs.at(entry.first.first), entry.first.second, entry.second);
+
+        chunk.assign(nChunk, Overlay());
+        std::atomic<Long64_t> next(0);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < std::min<Long64_t>(nThreads, nChunk); t++)
+            workers.emplace_back([&]()
+            {
+                for (Long64_t k = next++; k < nChunk; k = next++)
+                {
+                    Long64_t event = first + k;
+                    Overlay& overlay = chunk.at(k);
+                    TRandom3 random(EventSeed(seed, event) | 1);
+                    std::unordered_map<ULong64_t, double> cells;
+
+                    for (const auto& source : Sources(inputs, event, pileup, firstPileup, nPool, random))
+                        Add(digitizer, inputs.at(source.first), source.first, cache.at(source), cells, overlay);
+
+                    for (auto i : cells)
+                    {
+                        overlay.fRawCellID.emplace_back(i.first);
+                        overlay.fRawEnergy.emplace_back(i.second);
+                    }
+                    digitizer.Digitise(cells, random, overlay.fCellID, overlay.fEnergy, overlay.fX, overlay.fY, overlay.fZ);
+                }
+            });
+        for (auto& worker : workers)
+            worker.join();
+
+        for (Long64_t k = 0; k < nChunk; k++)
+        {
+            eventID = first + k;
+            std::swap(row, chunk.at(k));
+            tree->Fill();
+        }
+        std::cout << "Overlaid " << first + nChunk << " / " << nEvents << " events" << std::endl;
+    }
+
+    tree->Write("", TObject::kOverwrite);
+    fout->Close();
+    std::cout << "Written " << nEvents << " overlaid events of " << inputs.size() << " input(s) into " << output << std::endl;
+
+    return 0;
+}
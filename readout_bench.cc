@@ -0,0 +1,184 @@
+#include "Digitizer.hh"
+#include "StepStream.hh"
+#include "TFile.h"
+#include "TTree.h"
+#include "TRandom3.h"
+#include "yaml-cpp/yaml.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Stand-in for a recorded stream: HCAL showers of nSteps deposits around the centre, starting in the first layers
+void Generate(const Digitizer& digitizer, const int& nLayer, const long& nEvents, const long& nSteps, std::vector<std::vector<StepStream::Step>>& events)
+{
+    TRandom3 random(2022);
+    int nX = digitizer.GetNCellX(), nY = digitizer.GetNCellY();
+    events.assign(nEvents, {});
+    for (auto& event : events)
+    {
+        event.reserve(nSteps);
+        double start = random.Exp(3.0);
+        for (long i = 0; i < nSteps; i++)
+        {
+            int layer = std::min(nLayer - 1, static_cast<int>(start + random.Exp(6.0)));
+            int x = std::max(0, std::min(nX - 1, static_cast<int>(0.5 * nX + random.Gaus(0.0, 1.5))));
+            int y = std::max(0, std::min(nY - 1, static_cast<int>(0.5 * nY + random.Gaus(0.0, 1.5))));
+            event.push_back({CellID::kHcal, CellID::CopyNo(layer, x, y, nX, nY), random.Exp(0.5)});
+        }
+    }
+}
+
+double Seconds(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    std::string config, input, output = "readout_bench.root";
+    long nEvents = 1000, nSteps = 20000;
+    int nRepeats = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == std::string("-h") || std::string(argv[i]) == std::string("-help"))
+        {
+            std::cout << std::endl;
+            std::cout << "Help information" << std::endl << std::endl;
+            std::cout << "Replay a recorded stream:  calo-readout-bench -c [yaml] -i [steps.bin]" << std::endl;
+            std::cout << "Synthetic showers:         calo-readout-bench -c [yaml] -n [events] -s [steps per event]  (default: 1000, 20000)" << std::endl;
+            std::cout << "Repetitions:               calo-readout-bench -r [n] ...          (default: 5, the fastest is kept)" << std::endl;
+            std::cout << "Tree file:                 calo-readout-bench -o [file.root] ...  (default: readout_bench.root, removed at the end)" << std::endl << std::endl;
+            std::cout << "Streams are recorded by calo with record_steps in the Profile section. The deposits are booked," << std::endl;
+            std::cout << "decoded, digitised and filled into a tree as in calo, using the ECAL and HCAL sections of the" << std::endl;
+            std::cout << "YAML file, and the time of each stage is reported per step and per event." << std::endl << std::endl;
+            return 1;
+        }
+
+        else if (std::string(argv[i]) == std::string("-c") && i + 1 < argc)
+            config = argv[++i];
+
+        else if (std::string(argv[i]) == std::string("-i") && i + 1 < argc)
+            input = argv[++i];
+
+        else if (std::string(argv[i]) == std::string("-o") && i + 1 < argc)
+            output = argv[++i];
+
+        else if (std::string(argv[i]) == std::string("-n") && i + 1 < argc)
+            nEvents = std::stol(argv[++i]);
+
+        else if (std::string(argv[i]) == std::string("-s") && i + 1 < argc)
+            nSteps = std::stol(argv[++i]);
+
+        else if (std::string(argv[i]) == std::string("-r") && i + 1 < argc)
+            nRepeats = std::max(1, std::stoi(argv[++i]));
+    }
+
+    if (config.empty())
+    {
+        std::cout << "No configuration file given! Execute \"calo-readout-bench -h\" to display help message." << std::endl;
+        return 1;
+    }
+    YAML::Node conf = YAML::LoadFile(config);
+    Digitizer digitizer(conf);
+
+    std::vector<std::vector<StepStream::Step>> events;
+    if (!input.empty())
+    {
+        if (!StepStream::Read(input, events))
+        {
+            std::cout << "Cannot read " << input << "!" << std::endl;
+            return 1;
+        }
+    }
+    else
+        Generate(digitizer, conf["HCAL"]["nLayer"].as<int>(), nEvents, nSteps, events);
+    long totalSteps = 0;
+    for (const auto& event : events)
+        totalSteps += event.size();
+    if (events.empty() || totalSteps == 0)
+    {
+        std::cout << "No deposits to replay!" << std::endl;
+        return 1;
+    }
+    std::cout << events.size() << " events, " << totalSteps << " deposits" << (input.empty() ? " (synthetic)" : "") << std::endl;
+
+    // The buffers and branches of calo
+    std::unordered_map<ULong64_t, double> cells;
+    std::vector<ULong64_t> cellID;
+    std::vector<double> energy, x, y, z;
+    TRandom3 random;
+    std::unique_ptr<TFile> file(TFile::Open(output.c_str(), "RECREATE"));
+    // Owned by the file
+    TTree* tree = new TTree("Calib_Hit", "Readout benchmark");
+    tree->Branch("CellID", &cellID);
+    tree->Branch("Hit_Energy", &energy);
+    tree->Branch("Hit_X", &x);
+    tree->Branch("Hit_Y", &y);
+    tree->Branch("Hit_Z", &z);
+
+    // Fastest time in s of each stage over the repetitions: booking, decoding, digitisation, tree fill
+    const char* kStages[4] = {"book deposits", "decode cell IDs", "digitise", "fill tree"};
+    double best[4] = {1e30, 1e30, 1e30, 1e30};
+    long nCells = 0;
+    // Keeps the decoded positions from being optimised away
+    volatile double sum = 0.0;
+    for (int repeat = 0; repeat < nRepeats; repeat++)
+    {
+        double time[4] = {0.0, 0.0, 0.0, 0.0};
+        nCells = 0;
+        for (const auto& event : events)
+        {
+            auto start = std::chrono::steady_clock::now();
+            cells.clear();
+            for (const auto& step : event)
+                digitizer.Deposit(cells, static_cast<CellID::Subdetector>(step.fSubdetector), step.fCopyNo, step.fEdep);
+            time[0] += Seconds(start);
+
+            // Decoding alone, which the digitisation also does for the cells above threshold
+            start = std::chrono::steady_clock::now();
+            for (const auto& cell : cells)
+            {
+                double cellX, cellY, cellZ;
+                digitizer.Position(cell.first, cellX, cellY, cellZ);
+                sum = sum + cellX + cellY + cellZ;
+            }
+            time[1] += Seconds(start);
+            nCells += cells.size();
+
+            start = std::chrono::steady_clock::now();
+            digitizer.Digitise(cells, random, cellID, energy, x, y, z);
+            time[2] += Seconds(start);
+
+            start = std::chrono::steady_clock::now();
+            tree->Fill();
+            time[3] += Seconds(start);
+        }
+        for (int i = 0; i < 4; i++)
+            best[i] = std::min(best[i], time[i]);
+    }
+
+    std::cout << std::endl << std::left << std::setw(20) << "Stage" << std::right << std::setw(14) << "ns/step" << std::setw(14) << "ns/event" << std::endl;
+    double total = 0.0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (int i = 0; i < 4; i++)
+    {
+        total += best[i];
+        std::cout << std::left << std::setw(20) << kStages[i] << std::right << std::setw(14) << 1e9 * best[i] / totalSteps
+                  << std::setw(14) << 1e9 * best[i] / events.size() << std::endl;
+    }
+    std::cout << std::left << std::setw(20) << "total" << std::right << std::setw(14) << 1e9 * total / totalSteps
+              << std::setw(14) << 1e9 * total / events.size() << std::endl;
+    std::cout << std::endl << std::setprecision(1) << static_cast<double>(nCells) / events.size() << " cells per event, fastest of "
+              << nRepeats << " repetitions" << std::endl;
+
+    file->Close();
+    std::remove(output.c_str());
+    return 0;
+}
@@ -0,0 +1,55 @@
+#!/bin/bash
+# Compare the CPU time and the response with and without Woodcock tracking of gamma
+# Usage: scripts/woodcock_benchmark.sh [config.yaml] [region] [events]
+#   config.yaml: base configuration, e.g. a gamma or pi- beam into the HCAL (default: default.yaml)
+#   region:      ecal_region or hcal_region (default: hcal_region)
+
+config=${1:-default.yaml}
+region=${2:-hcal_region}
+events=${3:-1000}
+
+run()
+{
+    local name=$1
+    local woodcock=$2
+    sed -e "s|^\(    woodcock:\).*|\1 \"${woodcock}\"|" \
+        -e "s|^\(    output:\).*|\1 ./woodcock_${name}.root|" \
+        -e "s|^\(    beamon:\).*|\1 ${events}|" \
+        -e "s|^\(    cache:\).*|\1 \"\"|" \
+        ${config} > woodcock_${name}.yaml
+    # Configurations older than the woodcock key get it under FastSim, or in a new FastSim section
+    if ! grep -q "^    woodcock:" woodcock_${name}.yaml
+    then
+        if grep -q "^FastSim:" woodcock_${name}.yaml
+        then
+            sed -i "s|^FastSim:.*|&\n    woodcock: \"${woodcock}\"|" woodcock_${name}.yaml
+        else
+            printf "\nFastSim:\n    woodcock: \"%s\"\n" "${woodcock}" >> woodcock_${name}.yaml
+        fi
+    fi
+    if [ "$(grep -c "^    woodcock: \"${woodcock}\"" woodcock_${name}.yaml)" != "1" ]
+    then
+        echo "Cannot set woodcock: \"${woodcock}\" in woodcock_${name}.yaml from ${config}" >&2
+        exit 1
+    fi
+    local start=$(date +%s.%N)
+    calo -c woodcock_${name}.yaml > woodcock_${name}.log 2>&1
+    local end=$(date +%s.%N)
+    echo "$(echo "${end} - ${start}" | bc)"
+}
+
+echo "Running ${events} events of ${config}..."
+t_off=$(run off "") || exit 1
+t_on=$(run on ${region}) || exit 1
+echo "Without Woodcock tracking: ${t_off} s"
+echo "With Woodcock tracking in ${region}: ${t_on} s"
+echo "Speed-up: $(echo "scale=2; ${t_off} / ${t_on}" | bc)"
+
+# The response must not change beyond statistical fluctuations
+for name in off on
+do
+    root -l -b -q -e "TFile f(\"woodcock_${name}.root\"); TTree* t = (TTree*)f.Get(\"Calib_Hit\");
+        t->Draw(\"Sum\$(Hit_Energy)>>h${name}\", \"\", \"goff\"); TH1* h = (TH1*)gDirectory->Get(\"h${name}\");
+        printf(\"%s: visible energy %.3f +- %.3f MeV, RMS %.3f MeV, %.1f hits\\n\", \"${name}\", h->GetMean(), h->GetMeanError(), h->GetRMS(),
+               t->GetEntries() ? (double)t->Draw(\"Hit_Energy\", \"\", \"goff\") / t->GetEntries() : 0.0);"
+done
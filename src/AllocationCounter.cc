@@ -0,0 +1,99 @@
+#include "AllocationCounter.hh"
+
+#ifdef CALO_ALLOC_COUNT
+
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <vector>
+
+thread_local long AllocationCounter::fgAllocations = 0;
+thread_local long AllocationCounter::fgBytes = 0;
+
+namespace
+{
+    std::mutex& GetMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::vector<AllocationCounter::Site*>& GetSites()
+    {
+        static std::vector<AllocationCounter::Site*> sites;
+        return sites;
+    }
+}
+
+AllocationCounter::Site::Site(const char* name) : fName(name), fCalls(0), fAllocations(0), fBytes(0)
+{
+    std::lock_guard<std::mutex> lock(GetMutex());
+    GetSites().emplace_back(this);
+}
+
+void AllocationCounter::Reset()
+{
+    std::lock_guard<std::mutex> lock(GetMutex());
+    for (auto site : GetSites())
+        site->fCalls = site->fAllocations = site->fBytes = 0;
+}
+
+void AllocationCounter::Print(std::ostream& out, const long& nEvents)
+{
+    if (nEvents <= 0)
+        return;
+    std::lock_guard<std::mutex> lock(GetMutex());
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "Heap allocations per event after " << kWarmUp << " events:" << std::endl;
+    out << std::fixed << std::setprecision(2);
+    for (auto site : GetSites())
+    {
+        out << "  " << std::left << std::setw(28) << site->fName << std::right << std::setw(12) << static_cast<double>(site->fAllocations) / nEvents
+            << " allocations " << std::setw(14) << static_cast<double>(site->fBytes) / nEvents << " bytes in " << site->fCalls << " calls";
+        if (site->fAllocations > 0)
+            out << "  <- expected 0 in steady state";
+        out << std::endl;
+    }
+    out << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
+
+// Replacement of the global allocation functions; nothrow and array forms end up here, aligned ones are left alone
+void* operator new(std::size_t size)
+{
+    AllocationCounter::fgAllocations++;
+    AllocationCounter::fgBytes += size;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#endif
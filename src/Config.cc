@@ -1,14 +1,128 @@
 #include "Config.hh"
+#include "G4Version.hh"
+#include "RVersion.h"
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <unistd.h>
+#include <sys/stat.h>
 using namespace std;
 
-Config::Config() {}
+#ifndef CALO_VERSION
+#define CALO_VERSION "unknown"
+#endif
+
+namespace
+{
+    // Settings which only concern bookkeeping, and never change the content of an event
+    const set<string> kBookkeepingSections = {"Project", "Author", "Email", "Verbose", "Profile", "Navigation"};
+    const set<string> kBookkeepingGlobal = {"useseed", "seed", "usemac", "mac", "output", "beamon", "savegeo", "shard", "checkpoint", "cache"};
+    // Settings which do not change the content of the output file
+    const set<string> kOutputInvariantGlobal = {"usemac", "mac", "output", "checkpoint", "cache"};
+
+    // Write a node with sorted map keys, so that the result does not depend on the order in the YAML file
+    void Canonicalise(const YAML::Node& node, string& out)
+    {
+        if (node.IsMap())
+        {
+            // Sort the keys only; assigning YAML::Node objects would rebind the nodes they refer to
+            vector<string> keys;
+            for (auto item : node)
+                keys.emplace_back(item.first.as<string>());
+            sort(keys.begin(), keys.end());
+
+            out += '{';
+            for (const auto& key : keys)
+            {
+                out += key + ':';
+                Canonicalise(node[key], out);
+                out += ',';
+            }
+            out += '}';
+        }
+        else if (node.IsSequence())
+        {
+            out += '[';
+            for (auto item : node)
+            {
+                Canonicalise(item, out);
+                out += ',';
+            }
+            out += ']';
+        }
+        else if (node.IsScalar())
+            out += to_string(node.Scalar().size()) + '"' + node.Scalar();
+        else
+            out += '~';
+    }
+
+    // 64-bit FNV-1a
+    uint64_t HashString(const string& str)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : str)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // Hash of all sections except bookkeeping ones, and of the Global settings not in excludedGlobal
+    uint64_t HashConfig(YAML::Node& conf, const set<string>& excludedGlobal, const string& salt)
+    {
+        string canonical = salt;
+        vector<string> sections;
+        for (auto section : conf)
+            sections.emplace_back(section.first.as<string>());
+        sort(sections.begin(), sections.end());
+
+        for (const auto& name : sections)
+        {
+            if (kBookkeepingSections.count(name))
+                continue;
+            canonical += name + ':';
+            if (name == "Global")
+            {
+                YAML::Node kept(YAML::NodeType::Map);
+                for (auto item : conf["Global"])
+                    if (!excludedGlobal.count(item.first.as<string>()))
+                        kept[item.first.as<string>()] = item.second;
+                Canonicalise(kept, canonical);
+            }
+            else
+                Canonicalise(conf[name], canonical);
+            canonical += ';';
+        }
+
+        return HashString(canonical);
+    }
+
+    G4bool CopyFile(const string& from, const string& to)
+    {
+        ifstream fin(from, ios::binary);
+        ofstream fout(to, ios::binary);
+        fout << fin.rdbuf();
+        return fin.good() && fout.good();
+    }
+}
+
+volatile std::sig_atomic_t Config::fSignal = 0;
+
+Config::Config()
+ : fSeed(0), fResume(false), fExtend(0), fReplay(-1), fReplayVerbose(false), fNavigation(false), fFirstEvent(0), fProcessed(0)
+{}
 
 Config::~Config() {}
 
 void Config::Parse(const string& config_file)
 {
     UI = G4UImanager::GetUIpointer();
-    conf = YAML::LoadFile(config_file);
+    {
+        RunSummary::Scope scope(fSummary, "parse");
+        conf = YAML::LoadFile(config_file);
+    }
 
     if (conf["Project"].IsDefined())
         G4cout << "Configuration file loaded successfully" << G4endl;
@@ -25,12 +139,32 @@ G4int Config::Run()
 {
     // Choose the Random engine
     CLHEP::HepRandom::setTheEngine(new CLHEP::RanecuEngine);
-    if (conf["Global"]["useseed"].as<G4bool>())
-        CLHEP::HepRandom::setTheSeed(conf["Global"]["seed"].as<G4long>());
+    if (fReplay >= 0)
+    {
+        // The seed of the run which simulated the event, as recorded in the output, whatever useseed says
+        RunInfo run;
+        if (!HistoManager::findRun(conf["Global"]["output"].as<string>(), fReplay, run))
+            return 0;
+        if (run.fConfigHash != GetConfigHash())
+        {
+            G4cout << "Event " << fReplay << " was simulated with a different configuration; it cannot be replayed" << G4endl;
+            return 0;
+        }
+        fSeed = run.fSeed;
+    }
+    else if (conf["Global"]["useseed"].as<G4bool>())
+        fSeed = conf["Global"]["seed"].as<G4long>();
     else
-        CLHEP::HepRandom::setTheSeed(this->GetTimeNs());
+        fSeed = this->GetTimeNs();
+    CLHEP::HepRandom::setTheSeed(fSeed);
     CLHEP::HepRandom::showEngineStatus();
     G4cout << "seed: " << CLHEP::HepRandom::getTheSeed() << G4endl;
+    G4cout << "config hash: " << hex << setw(16) << setfill('0') << GetConfigHash() << dec << setfill(' ') << G4endl;
+
+    // The same sample may have been produced already
+    string output = conf["Global"]["output"].as<string>();
+    if (!fNavigation && FetchFromCache(output))
+        return 1;
 
     // Construct the default run manager
     // Verbose output class
@@ -39,17 +173,51 @@ G4int Config::Run()
 
     // Set mandatory initialisation classes
     DetectorConstruction* detector = new DetectorConstruction(this);
-    if (conf["Global"]["savegeo"].as<G4bool>())
-    {
-    	G4GDMLParser parser;
-    	parser.Write("cepc-calo.gdml",detector->Construct());
-    }
     runManager->SetUserInitialization(detector);
+    if (fNavigation)
+        return RunNavigation(runManager);
+
+    // Frozen-shower library of the HCAL, either being generated or used
+    ShowerLibrary* library = new ShowerLibrary(this);
+    StepProfiler* profiler = conf["Profile"]["steps"].as<G4bool>(false) ? new StepProfiler(this) : 0;
+    PerfCounters* counters = conf["Profile"]["counters"].as<G4bool>(false) ? new PerfCounters() : 0;
+    fSummary.SetCounters(counters);
+    string metricsFile = conf["Profile"]["metrics"].as<string>("");
+    ProgressMetrics* metrics = metricsFile.empty() ? 0 : new ProgressMetrics(metricsFile, conf["Profile"]["metrics_interval"].as<G4double>(10.0));
+    string stepFile = conf["Profile"]["record_steps"].as<string>("");
+    StepStream* steps = stepFile.empty() ? 0 : new StepStream(stepFile);
 
-    G4VUserPhysicsList* physics = new QGSP_BERT();
+    G4VModularPhysicsList* physics = new QGSP_BERT();
+    G4bool gflash = conf["FastSim"]["gflash"].as<G4bool>(false);
+    if (gflash || library->IsLoaded())
+    {
+        // Fast-simulation process, used by the GFlash model in the ECAL region and the frozen-shower model in the HCAL region
+        G4FastSimulationPhysics* fastSimulation = new G4FastSimulationPhysics();
+        fastSimulation->ActivateFastSimulation("e-");
+        fastSimulation->ActivateFastSimulation("e+");
+        if (library->IsLoaded())
+            fastSimulation->ActivateFastSimulation("gamma");
+        physics->RegisterPhysics(fastSimulation);
+    }
     runManager->SetUserInitialization(physics);
 
-    HistoManager* histo = new HistoManager(conf["Global"]["output"].as<string>().c_str(), conf["Global"]["savegeo"].as<G4bool>());
+    // Woodcock (delta) tracking of photons in one of the calorimeter envelopes, where the steps are otherwise limited by the thin layers
+    string woodcock = conf["FastSim"]["woodcock"].as<string>("");
+    if (!woodcock.empty())
+    {
+#if G4VERSION_NUMBER >= 1120
+        G4EmParameters::Instance()->SetGeneralProcessActive(true);
+        G4EmParameters::Instance()->SetWoodcockActiveRegion(woodcock);
+        G4cout << "Woodcock tracking of gamma is used in " << woodcock << G4endl;
+#else
+        G4cout << "Woodcock tracking requires Geant4 11.2 or later; " << woodcock << " is tracked normally." << G4endl;
+#endif
+    }
+
+    if (fReplay >= 0)
+        fSibling = output.substr(0, output.rfind(".root")) + "_event" + to_string(fReplay) + ".root";
+    HistoManager* histo = new HistoManager(fSibling.empty() ? output.c_str() : fSibling.c_str(), conf["Global"]["savegeo"].as<G4bool>(),
+                                           conf["Global"]["saveraw"].as<G4bool>(false), conf["Profile"]["events"].as<G4bool>(false));
 //    SteppingVerbose* stepV = new SteppingVerbose();
 
     PrimaryGeneratorAction* primary = new PrimaryGeneratorAction(detector, histo, this);
@@ -64,31 +232,228 @@ G4int Config::Run()
     TrackingAction* trackingAction = new TrackingAction(runAction, eventAction, this);
     runManager->SetUserAction(trackingAction);
 
-    SteppingAction* steppingAction = new SteppingAction(detector, eventAction);
+    SteppingAction* steppingAction = new SteppingAction(detector, eventAction, this);
     runManager->SetUserAction(steppingAction);
 
+    StackingAction* stackingAction = new StackingAction(eventAction, this);
+    runManager->SetUserAction(stackingAction);
+
     runManager->SetVerboseLevel(conf["Verbose"]["run"].as<G4int>());
     G4String command = "/control/execute ";
 
     UI->ApplyCommand(G4String("/control/verbose ") + G4String(conf["Verbose"]["control"].as<string>()));
     UI->ApplyCommand(G4String("/tracking/verbose ") + G4String(conf["Verbose"]["tracking"].as<string>()));
     UI->ApplyCommand(G4String("/event/verbose ") + G4String(conf["Verbose"]["event"].as<string>()));
+    if (fReplayVerbose)
+        UI->ApplyCommand("/tracking/verbose 1");
 
     for (auto subconf : conf["Source"])
         UI->ApplyCommand("/gps/" + subconf.first.as<string>() + " " + subconf.second.as<string>());
 
-    // Initialise G4 kernel
+    // Batch systems send SIGTERM before preemption; SIGUSR1 only asks for a checkpoint
+    std::signal(SIGTERM, Config::HandleSignal);
+    std::signal(SIGUSR1, Config::HandleSignal);
+
+    // Initialise G4 kernel; the physics tables are only built at the start of the run
+    fSummary.Start("initialize");
     runManager->Initialize();
-    runManager->BeamOn(conf["Global"]["beamon"].as<G4int>());
+    fSummary.Stop("initialize");
+    // Written from the world built by the initialisation, for HistoManager::save
+    if (conf["Global"]["savegeo"].as<G4bool>())
+    {
+        RunSummary::Scope scope(fSummary, "gdml");
+        G4GDMLParser parser;
+        parser.Write("cepc-calo.gdml", detector->GetphysiWorld());
+    }
+
+    G4int nEvents = conf["Global"]["beamon"].as<G4int>();
+    if (fReplay >= 0)
+    {
+        // Every event is seeded from (seed, event ID), so the event can be simulated on its own
+        fFirstEvent = fReplay;
+        histo->fRunInfo.fFirstEvent = fReplay;
+        nEvents = 1;
+        G4cout << "Replaying event " << fReplay << " into " << fSibling << G4endl;
+    }
+    else if (fResume || fExtend > 0)
+    {
+        // The random streams continue exactly where the checkpoint left them
+        fFirstEvent = histo->restore(GetConfigHash(), fSeed, output);
+        G4bool complete = (fFirstEvent >= 0 && fExtend == 0 && fFirstEvent >= nEvents);
+        if (complete)
+            G4cout << output << " already has " << fFirstEvent << " event(s), beamon is " << nEvents << "; nothing to resume (use --extend to add events)" << G4endl;
+        if (fFirstEvent < 0 || complete)
+        {
+            delete runManager;
+            delete library;
+            delete profiler;
+            fSummary.SetCounters(0);
+            delete counters;
+            delete metrics;
+            delete steps;
+            return 0;
+        }
+        nEvents = (fExtend > 0) ? fExtend : nEvents - fFirstEvent;
+        G4cout << "Continuing " << output << " from event " << fFirstEvent << ", " << nEvents << " event(s) to go" << G4endl;
+    }
+    if (nEvents > 0)
+    {
+        // Stopped by RunAction::BeginOfRunAction, after the physics tables
+        fSummary.Start("physics tables");
+        runManager->BeamOn(nEvents);
+    }
 
     // Job termination
+    fSummary.Start("termination");
+    delete runManager;
+    delete library;
+    delete profiler;
+    fSummary.Stop("termination");
+    WriteSummary();
+#ifdef CALO_TRACE
+    string trace = conf["Profile"]["trace"].as<string>("trace.json");
+    if (Trace::Write(trace))
+        G4cout << "Trace written into " << trace << " (open in chrome://tracing or ui.perfetto.dev)" << G4endl << G4endl;
+#endif
+    fSummary.SetCounters(0);
+    delete counters;
+    delete metrics;
+    delete steps;
+    if (access("cepc-calo.gdml", F_OK) == 0)
+        remove("cepc-calo.gdml");
+    // A run stopped by SIGTERM leaves a partial file, which must not be cached under the hash of the full sample
+    if (fReplay < 0 && fExtend == 0 && PendingSignal() == 0 && fFirstEvent + fProcessed == conf["Global"]["beamon"].as<G4long>())
+        StoreInCache(output);
+
+    return 1;
+}
+
+G4int Config::RunNavigation(G4RunManager* runManager)
+{
+    // Geantinos only have the transportation; no output file is written
+    runManager->SetUserInitialization(new QGSP_BERT());
+    NavigationBenchmark* navigation = new NavigationBenchmark(this);
+    navigation->SetUserActions(runManager);
+    runManager->SetVerboseLevel(conf["Verbose"]["run"].as<G4int>());
+    UI->ApplyCommand(G4String("/control/verbose ") + G4String(conf["Verbose"]["control"].as<string>()));
+    UI->ApplyCommand(G4String("/tracking/verbose ") + G4String(conf["Verbose"]["tracking"].as<string>()));
+
+    fSummary.Start("initialize");
+    runManager->Initialize();
+    fSummary.Stop("initialize");
+    navigation->Run(runManager);
+
+    fSummary.Start("termination");
     delete runManager;
+    delete navigation;
+    fSummary.Stop("termination");
+    WriteSummary();
     if (access("cepc-calo.gdml", F_OK) == 0)
         remove("cepc-calo.gdml");
 
     return 1;
 }
 
+void Config::WriteSummary()
+{
+    fSummary.Print(G4cout);
+    string file = conf["Profile"]["summary"].as<string>("");
+    if (file.empty())
+        return;
+    if (fSummary.Write(file))
+        G4cout << "Run summary written into " << file << G4endl << G4endl;
+    else
+        G4cout << "Run summary could not be written into " << file << G4endl << G4endl;
+}
+
+uint64_t Config::GetEventSeed(const G4long& eventID, const G4int& stream) const
+{
+    // SplitMix64 finaliser of the run seed mixed with (event ID, stream); streams above 1 go to the high bits, so they never meet another event
+    uint64_t counter = 2 * static_cast<uint64_t>(eventID) + (stream & 1) + 1 + (static_cast<uint64_t>(stream >> 1) << 56);
+    uint64_t x = static_cast<uint64_t>(fSeed) ^ (0x9E3779B97F4A7C15ULL * counter);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t Config::GetConfigHash()
+{
+    return HashConfig(conf, kBookkeepingGlobal, "");
+}
+
+uint64_t Config::GetSampleHash()
+{
+    // The same settings give a different sample with another build of the program
+    ostringstream build;
+    build << CALO_VERSION << '|' << G4Version << '|' << ROOT_RELEASE << '|';
+    // Profile is bookkeeping, except for the Event_* branches it adds to the output
+    if (conf["Profile"]["events"].as<G4bool>(false))
+        build << "events|" << (conf["Profile"]["counters"].as<G4bool>(false) ? "counters|" : "");
+    return HashConfig(conf, kOutputInvariantGlobal, build.str());
+}
+
+string Config::GetCachePath()
+{
+    string cache = conf["Global"]["cache"].as<string>("");
+    if (cache.empty() || !conf["Global"]["useseed"].as<G4bool>() || fResume || fExtend > 0 || fReplay >= 0)
+        return "";
+    // A frozen-shower library or a recorded step stream is a second output, which the cache does not keep
+    if (!conf["FastSim"]["frozen_generate"].as<string>("").empty() || !conf["Profile"]["record_steps"].as<string>("").empty())
+        return "";
+
+    ostringstream path;
+    path << cache << "/" << hex << setw(16) << setfill('0') << GetSampleHash() << ".root";
+    return path.str();
+}
+
+void Config::LogCache(const string& action, const string& output)
+{
+    time_t now = time(nullptr);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    ofstream log(conf["Global"]["cache"].as<string>() + "/cache.log", ios::app);
+    log << date << "  " << action << "  " << GetCachePath() << "  " << output << endl;
+}
+
+G4bool Config::FetchFromCache(const string& output)
+{
+    string cached = GetCachePath();
+    if (cached.empty() || access(cached.c_str(), R_OK) != 0)
+        return false;
+
+    remove(output.c_str());
+    if (link(cached.c_str(), output.c_str()) != 0 && !CopyFile(cached, output))
+    {
+        G4cout << "Cannot take " << cached << " from the cache, simulating instead" << G4endl;
+        remove(output.c_str());
+        return false;
+    }
+
+    G4cout << "Cache hit: " << output << " is identical to " << cached << ", nothing to simulate" << G4endl;
+    LogCache("hit", output);
+    return true;
+}
+
+void Config::StoreInCache(const string& output)
+{
+    string cached = GetCachePath();
+    if (cached.empty() || access(cached.c_str(), F_OK) == 0)
+        return;
+
+    // A copy, so that the output stays writable; under a temporary name first, so that other jobs never see a partial file
+    string temporary = cached + ".tmp" + to_string(getpid());
+    if (!CopyFile(output, temporary) || rename(temporary.c_str(), cached.c_str()) != 0)
+    {
+        G4cout << "Cannot store " << output << " in the cache" << G4endl;
+        remove(temporary.c_str());
+        return;
+    }
+
+    // Read-only, so that the shared copy (and outputs linked to it) cannot be modified in place, e.g., by --extend
+    chmod(cached.c_str(), S_IRUSR | S_IRGRP | S_IROTH);
+    LogCache("store", output);
+}
+
 G4int Config::Print()
 {
     ofstream fout("./default.yaml");
@@ -111,12 +476,72 @@ G4int Config::Print()
     fout << "    output: ./test.root    # Output ROOT file name" << endl;
     fout << "    beamon: 100" << endl;
     fout << "    savegeo: false" << endl;
+    fout << "    saveraw: false    # Also save the cell deposits before digitisation (Raw_CellID, Raw_Energy), needed by calo-overlay" << endl;
+    fout << "    cache: \"\"    # Directory of produced samples; an identical earlier sample is reused instead of simulated (only with useseed)" << endl;
+    fout << "    checkpoint: 0    # Save the tree and the random state every N events (0: only at the end); needed by calo --resume" << endl;
+    fout << "    shard: 0    # Index of this job in a sharded production, kept in the RunInfo tree" << endl;
     fout << endl << endl;
     fout << "# Calorimeter construction" << endl;
     fout << "Geometry:" << endl;
     fout << "    build_ECAL: false" << endl;
     fout << "    build_HCAL: true" << endl;
     fout << endl << endl;
+    fout << "# Local-deposition approximation: e+/e-/gamma created in these passive volumes are killed, and their energy is booked in Edep_Local" << endl;
+    fout << "LocalDeposit:" << endl;
+    fout << "    enable: false" << endl;
+    for (const string& volume : {"hcal_absorber0", "hcal_absorber", "hcal_pcb"})
+    {
+        fout << "    " << volume << ":" << endl;
+        fout << "        ecut: 0.1    # Kinetic energy threshold in MeV" << endl;
+        fout << "        range: true    # Also electrons whose range is shorter than the distance to the volume boundary" << endl;
+    }
+    fout << endl << endl;
+    fout << "# Augmentation: shifted (and mirrored) copies of each HCAL event, with the same EventID and CopyID 1..copies" << endl;
+    fout << "Augment:" << endl;
+    fout << "    copies: 0    # Number of copies per simulated event; only without ECAL" << endl;
+    fout << "    margin: 1    # Minimum distance in cells between the deposits of a copy and the HCAL edges" << endl;
+    fout << "    mirror: false    # Also mirror the copies randomly in x and y" << endl;
+    fout << endl << endl;
+    fout << "# Budgets against pathological events (0: no limit); killed tracks and aborted events are logged with their seed, and flagged in the Status branch" << endl;
+    fout << "Budget:" << endl;
+    fout << "    track_steps: 0    # Maximum number of steps of a track, e.g., 100000" << endl;
+    fout << "    track_time: 0    # Maximum global time of a track in ns, e.g., 10000" << endl;
+    fout << "    event_wall: 0    # Maximum wall-clock time of an event in s, e.g., 600" << endl;
+    fout << endl << endl;
+    fout << "# Variance reduction; deposits are weighted, and the Weight branch keeps the mean weight of each event" << endl;
+    fout << "Biasing:" << endl;
+    fout << "    roulette: false    # Russian roulette of slow neutrons" << endl;
+    fout << "    roulette_emax: 1.0    # Kinetic energy threshold in MeV" << endl;
+    fout << "    roulette_survival: 0.1    # Survival probability; survivors get the weight 1 / roulette_survival" << endl;
+    fout << endl << endl;
+    fout << "# Fast simulation" << endl;
+    fout << "FastSim:" << endl;
+    fout << "    gflash: false    # GFlash parameterised e+/e- showers in the ECAL (requires build_ECAL)" << endl;
+    fout << "    gflash_emin: 1.0    # Minimum e+/e- energy to be parameterised, in GeV" << endl;
+    fout << "    woodcock: \"\"    # Woodcock tracking of gamma in ecal_region or hcal_region (Geant4 11.2 or later)" << endl;
+    fout << endl;
+    fout << "    frozen_generate: \"\"    # Record the EM sub-showers in the HCAL into this frozen-shower library file" << endl;
+    fout << "    frozen_library: \"\"    # Replace e+/e-/gamma in the HCAL by showers from this library file" << endl;
+    fout << "    frozen_emin: 0.01    # Energy range of the library, in GeV; particles outside are fully simulated" << endl;
+    fout << "    frozen_emax: 1.0" << endl;
+    fout << "    frozen_ebins: 10    # Logarithmic energy bins" << endl;
+    fout << "    frozen_zbins: 6    # Bins of the starting position within an HCAL layer" << endl;
+    fout << endl << endl;
+    fout << "# Structure of ECAL: layers of scintillator strips, rotated by 90 degrees in odd layers, behind CuW absorber plates" << endl;
+    fout << "# Its hits are written with the HCAL ones, and told apart by the subdetector field of the cell ID" << endl;
+    fout << "ECAL:" << endl;
+    fout << "    nLayer: 30" << endl;
+    fout << "    nStripX: 42    # Strips side by side" << endl;
+    fout << "    nStripY: 5    # Strips end to end" << endl;
+    fout << endl;
+    fout << "    StripWidth: 5    # In mm" << endl;
+    fout << "    StripLength: 45    # In mm" << endl;
+    fout << "    StripThick: 2    # In mm" << endl;
+    fout << endl;
+    fout << "    AbsorberXY: 230    # In mm" << endl;
+    fout << "    AbsorberThick: 2.8    # In mm" << endl;
+    fout << "    PCBThick: 2    # In mm" << endl;
+    fout <<  endl << endl;
     fout << "# Structure of HCAL" << endl;
     fout << "# Warning: Be careful while editing this section!  Non-standard structures have not been fully tested!" << endl;
     fout << "HCAL:" << endl;
@@ -146,6 +571,35 @@ G4int Config::Print()
     fout << "    ene/mono: \"100 GeV\"" << endl;
     fout << "    ene/sigma: \"0 MeV\"" << endl;
     fout << endl << endl;
+    fout << "# Performance profiling; not part of the configuration hash" << endl;
+    fout << "Profile:" << endl;
+    fout << "    steps: false    # Count steps, tracks and sampled CPU time by volume, particle and process" << endl;
+    fout << "    sample: 100    # Measure the CPU time of one step in N" << endl;
+    fout << "    report: 15    # Lines per table in the printed report" << endl;
+    fout << "    output: profile.json" << endl;
+    fout << endl;
+    fout << "    counters: false    # Cycles, instructions, cache and branch misses per event and phase from perf_event_open, if the kernel allows it" << endl;
+    fout << "    metrics: \"\"    # File of the progress for batch monitoring, rewritten periodically; Prometheus text format if it ends in .prom, JSON otherwise (empty: off)" << endl;
+    fout << "    metrics_interval: 10    # Seconds between two updates of the metrics file" << endl;
+    fout << "    record_steps: \"\"    # Record the deposits booked into the readout into this file, to be replayed by calo-readout-bench (empty: off)" << endl;
+    fout << "    trace: trace.json    # Timeline of the events and job phases, if built with -DWITH_TRACE=ON" << endl;
+    fout << "    summary: \"\"    # JSON file of the wall time, CPU time and memory of the job phases and the results of the run (empty: table only)" << endl;
+    fout << "    events: false    # Wall and CPU time, steps and cells with deposits of each event in the Event_* branches" << endl;
+    fout << "    slow_percentile: 0    # Log the seed and primaries of events slower than this percentile of the earlier ones, e.g., 99 (0: off)" << endl;
+    fout << endl << endl;
+    fout << "# Geantino navigation benchmark of calo -c [file] --navigation; not part of the configuration hash" << endl;
+    fout << "Navigation:" << endl;
+    fout << "    particles: \"geantino chargedgeantino\"" << endl;
+    fout << "    nX: 9    # Grid of nX x nY starting points, centred on the beam axis" << endl;
+    fout << "    nY: 9" << endl;
+    fout << "    width: 720    # In mm, side of the grid" << endl;
+    fout << "    z: -100    # In mm" << endl;
+    fout << "    nTheta: 4    # Polar angles from 0 to thetaMax" << endl;
+    fout << "    thetaMax: 30    # In deg" << endl;
+    fout << "    nPhi: 4    # Azimuths of every non-zero polar angle" << endl;
+    fout << "    repeat: 10    # Passes over the grid with each particle, one event each" << endl;
+    fout << "    report: 15    # Lines of the voxelisation table" << endl;
+    fout << endl << endl;
     fout << "# Verbose" << endl;
     fout << "Verbose:" << endl;
     fout << "    run: 0" << endl;
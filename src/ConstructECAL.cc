@@ -1,6 +1,7 @@
 #include "DetectorConstruction.hh"
 
 #include "SteppingAction.hh"
+#include "CellID.hh"
 
 #include "G4NistManager.hh"
 #include "G4Box.hh"
@@ -15,6 +16,7 @@
 #include "G4Element.hh"
 #include "G4Material.hh"
 #include "G4GlobalMagFieldMessenger.hh"
+#include "G4Region.hh"
 
 void DetectorConstruction::ConstructECAL()
 {
@@ -64,17 +66,20 @@ void DetectorConstruction::ConstructECAL()
 
     //******************************************************
     //Absorber & Crystal & PCB
-    G4int LayerNo = 30;
-    G4int crystalNoX = 42;
-    G4int crystalNoY = 5;
+    G4int LayerNo = config->conf["ECAL"]["nLayer"].as<G4int>(30);
+    G4int crystalNoX = config->conf["ECAL"]["nStripX"].as<G4int>(42);
+    G4int crystalNoY = config->conf["ECAL"]["nStripY"].as<G4int>(5);
     G4double absorberZ0 = 0 * mm;
-    G4double crystalX = 5 * mm;
-    G4double crystalY = 45 * mm;
-    G4double crystalZ = 2 * mm;
-    G4double absorberXY = 230 * mm;
-    G4double absorberZ = 2.8 * mm;
+    G4double crystalX = config->conf["ECAL"]["StripWidth"].as<G4double>(5.0) * mm;
+    G4double crystalY = config->conf["ECAL"]["StripLength"].as<G4double>(45.0) * mm;
+    G4double crystalZ = config->conf["ECAL"]["StripThick"].as<G4double>(2.0) * mm;
+    G4double absorberXY = config->conf["ECAL"]["AbsorberXY"].as<G4double>(230.0) * mm;
+    G4double absorberZ = config->conf["ECAL"]["AbsorberThick"].as<G4double>(2.8) * mm;
     G4double PCBXY = absorberXY;
-    G4double PCBZ = 2 * mm;
+    G4double PCBZ = config->conf["ECAL"]["PCBThick"].as<G4double>(2.0) * mm;
+    if (!CellID::Fits(LayerNo, crystalNoX, crystalNoY))
+        G4Exception("DetectorConstruction::ConstructECAL()", "ECAL001", FatalException,
+                    "Too many ECAL strips to be numbered with 32-bit copy numbers and 64-bit cell IDs");
     G4double crystalGapX = 0.0;
     G4double crystalGapY = 0.0;
     G4double absorber_crystalGap = 0 * mm;
@@ -102,6 +107,27 @@ void DetectorConstruction::ConstructECAL()
     G4double PCBGapZ = absorberGapZ;
     G4double crystalGapZ = absorberGapZ;
 
+    //******************************************************
+    //Envelope of all layers, which also defines the region of the GFlash fast simulation
+    G4double envelopeZ = 0.5 * (LayerNo * 0.5 * absorberGapZ);
+    G4Box*
+        solidEnvelope = new G4Box("ecal_envelope",
+                0.5*absorberXY, 0.5*absorberXY, envelopeZ);
+    G4LogicalVolume*
+        logicEnvelope = new G4LogicalVolume(solidEnvelope,
+                Vacuum,
+                "ecal_envelope");
+    new G4PVPlacement(0,
+            G4ThreeVector(0, 0, envelopeZ),
+            logicEnvelope,
+            "ecal_envelope",
+            logicWorld,
+            false,
+            0,
+            checkOverlaps);
+    logicEnvelope->SetVisAttributes(visAttributes);
+    fEcalRegion = EnvelopeRegion("ecal_region", logicEnvelope);
+
     //******************************************************
     //******************************************************
     //Absorber
@@ -134,20 +160,20 @@ void DetectorConstruction::ConstructECAL()
     for(G4int i_Layer=0; i_Layer!=LayerNo; ++i_Layer){
         if(i_Layer%2==0){
             new G4PVPlacement(0,                                                    // no rotation
-                    G4ThreeVector(0, 0, (absorberPositionZ1 + (i_Layer * 0.5) * absorberGapZ)),
+                    G4ThreeVector(0, 0, (absorberPositionZ1 + (i_Layer * 0.5) * absorberGapZ - envelopeZ)),
                     logicAbsorber,                                         // its logical volume
                     "ecal_absorber",                                            // its name
-                    logicWorld,                                           // its mother  volume
+                    logicEnvelope,                                        // its mother  volume
                     false,                                                // no boolean operation
                     i_Layer,
                     checkOverlaps);                                                   // copy number
         }
         if(i_Layer%2==1){
             new G4PVPlacement(0,                                                    // no rotation
-                    G4ThreeVector(0,0, (absorberPositionZ2 + (i_Layer * 0.5) * absorberGapZ)),
+                    G4ThreeVector(0,0, (absorberPositionZ2 + ((i_Layer - 1) * 0.5) * absorberGapZ - envelopeZ)),
                     logicAbsorber,                                         // its logical volume
                     "ecal_Absorber",                                            // its name
-                    logicWorld,                                           // its mother  volume
+                    logicEnvelope,                                        // its mother  volume
                     false,                                                // no boolean operation
                     i_Layer,
                     checkOverlaps);                                                   // copy number
@@ -176,13 +202,13 @@ void DetectorConstruction::ConstructECAL()
                 for(G4int i_Portrait = 0; i_Portrait != crystalNoX; ++i_Portrait)
                 {
                     new G4PVPlacement(0,                                                    // no rotation
-                            G4ThreeVector((crystalPositionX + i_Portrait * (crystalX + crystalGapX)), (crystalPositionY + i_Lands * (crystalY + crystalGapY)), (crystalPositionZ1 + i_Layer * 0.5 * crystalGapZ)),                                      // at ()
+                            G4ThreeVector((crystalPositionX + i_Portrait * (crystalX + crystalGapX)), (crystalPositionY + i_Lands * (crystalY + crystalGapY)), (crystalPositionZ1 + i_Layer * 0.5 * crystalGapZ - envelopeZ)),                                      // at ()
                             //G4Transform3D(rm, G4ThreeVector((crystalPositionY+i_Lands*(crystalY+crystalGapY)), (crystalPositionX+i_Portrait*(crystalX+crystalGapX)), (crystalPositionZ1+i_Layer/2*crystalGapZ))),                                      // at ()
                             logicCrystal,                                         // its logical volume
                             "ecal_crystal",                                            // its name
-                            logicWorld,                                           // its mother  volume
+                            logicEnvelope,                                        // its mother  volume
                             false,                                                // no boolean operation
-                            i_Layer*crystalNoX*crystalNoY + i_Lands*crystalNoX + i_Portrait );                                                   // copy number
+                            CellID::CopyNo(i_Layer, i_Portrait, i_Lands, crystalNoX, crystalNoY));              // copy number
                 }
             }
         }
@@ -194,12 +220,12 @@ void DetectorConstruction::ConstructECAL()
                 {
                     new G4PVPlacement(
                             //G4ThreeVector((crystalPositionX+i_Portrait*(crystalX+crystalGapX)), (crystalPositionY+i_Lands*(crystalY+crystalGapY)), (crystalPositionZ2+i_Layer/2*crystalGapZ)),                                      // at ()
-                            G4Transform3D(rm, G4ThreeVector((crystalPositionY+i_Lands*(crystalY+crystalGapY)), (crystalPositionX+i_Portrait*(crystalX+crystalGapX)), (crystalPositionZ2+(i_Layer-1)/2.*crystalGapZ))),                                      // at ()
+                            G4Transform3D(rm, G4ThreeVector((crystalPositionY+i_Lands*(crystalY+crystalGapY)), (crystalPositionX+i_Portrait*(crystalX+crystalGapX)), (crystalPositionZ2+(i_Layer-1)/2.*crystalGapZ-envelopeZ))),                                      // at ()
                             logicCrystal,                                         // its logical volume
                             "ecal_crystal",                                            // its name
-                            logicWorld,                                           // its mother  volume
+                            logicEnvelope,                                        // its mother  volume
                             false,                                                // no boolean operation
-                            i_Layer*crystalNoX*crystalNoY + i_Lands*crystalNoX + i_Portrait );                                                   // copy number
+                            CellID::CopyNo(i_Layer, i_Portrait, i_Lands, crystalNoX, crystalNoY));              // copy number
                 }
             }
         }
@@ -223,20 +249,20 @@ void DetectorConstruction::ConstructECAL()
     for(G4int i_Layer=0; i_Layer!=LayerNo; ++i_Layer){
         if(i_Layer%2==0){
             new G4PVPlacement(0,                                                    // no rotation
-                    G4ThreeVector(0,0, (PCBPositionZ1+i_Layer/2*PCBGapZ)),                                      // at (0,0,0)
+                    G4ThreeVector(0,0, (PCBPositionZ1+i_Layer/2*PCBGapZ-envelopeZ)),                                      // at (0,0,0)
                     logicPCB,                                         // its logical volume
                     "ecal_pcb",                                            // its name
-                    logicWorld,                                           // its mother  volume
+                    logicEnvelope,                                        // its mother  volume
                     false,                                                // no boolean operation
                     i_Layer,
                     checkOverlaps);                                                   // copy number
         }
         if(i_Layer%2==1){
             new G4PVPlacement(0,                                                    // no rotation
-                    G4ThreeVector(0,0, (PCBPositionZ2+i_Layer/2*PCBGapZ)),                                      // at (0,0,0)
+                    G4ThreeVector(0,0, (PCBPositionZ2+i_Layer/2*PCBGapZ-envelopeZ)),                                      // at (0,0,0)
                     logicPCB,                                         // its logical volume
                     "ecal_pcb",                                            // its name
-                    logicWorld,                                           // its mother  volume
+                    logicEnvelope,                                        // its mother  volume
                     false,                                                // no boolean operation
                     i_Layer,
                     checkOverlaps);                                                   // copy number
@@ -244,4 +270,11 @@ void DetectorConstruction::ConstructECAL()
     }
     logicAbsorber ->SetVisAttributes(visAttributes);
     logicPCB ->SetVisAttributes(visAttributes);
+
+    // Needed by the GFlash set-up in ConstructSDandField()
+    fEcalCrystal = logicCrystal;
+    fEcalAbsorberMaterial = CuW;
+    fEcalActiveMaterial = PSD;
+    fEcalAbsorberZ = absorberZ;
+    fEcalActiveZ = crystalZ;
 }
\ No newline at end of file
@@ -11,16 +11,16 @@
 #include "G4Element.hh"
 #include "G4Material.hh"
 #include "G4GlobalMagFieldMessenger.hh"
+#include "G4Region.hh"
 
 #include "DetectorConstruction.hh"
 #include "SteppingAction.hh"
+#include "Digitizer.hh"
 
 void DetectorConstruction::ConstructHCAL()
 {
     G4cout << "Construction of AHCAL begins now..." << G4endl;
-    G4double ecal_length = 0.0 * mm;
-    if (config->conf["Geometry"]["build_ECAL"].as<G4bool>())
-        ecal_length = 300.0 * mm;
+    G4double ecal_length = Digitizer::EcalLength(config->conf) * mm;
     G4cout << "AHCAL is constructed at z = " << ecal_length << " mm." << G4endl;
 
     // Parameters from YAML file
@@ -31,6 +31,9 @@ void DetectorConstruction::ConstructHCAL()
     G4double crystalY = config->conf["HCAL"]["CellWidthY"].as<G4double>() * mm;
     G4double gapX = config->conf["HCAL"]["GapX"].as<G4double>() * mm;
     G4double gapY = config->conf["HCAL"]["GapY"].as<G4double>() * mm;
+    if (!CellID::Fits(nLayer, nCellX, nCellY))
+        G4Exception("DetectorConstruction::ConstructHCAL()", "HCAL001", FatalException,
+                    "Too many HCAL cells to be numbered with 32-bit copy numbers and 64-bit cell IDs");
 
     G4NistManager* nistManager = G4NistManager::Instance();
 
@@ -112,6 +115,26 @@ void DetectorConstruction::ConstructHCAL()
 
     G4bool checkOverlap = false;    // No overlap checking triggered
 
+    // Envelope of all layers, which also defines the region of the frozen-shower model
+    G4Material* vacuum = nistManager->FindOrBuildMaterial("G4_Galactic");
+    G4double envelopeZ = absorberZ0 + gap_psd_abs0 + nLayer * thickness;
+    G4double envelopePositionZ = ecal_length + 0.5 * envelopeZ;
+    G4Box* solidEnvelope = new G4Box("hcal_envelope",                                   // Name
+                                     0.5 * PCBX, 0.5 * PCBY, 0.5 * envelopeZ);         // Size
+    G4LogicalVolume* logicEnvelope = new G4LogicalVolume(solidEnvelope,      // Solid
+                                                         vacuum,             // Material
+                                                         "hcal_envelope");   // Name
+    new G4PVPlacement(0,                                     // No rotation
+                      G4ThreeVector(0, 0, envelopePositionZ),
+                      logicEnvelope,                         // Logical volume
+                      "hcal_envelope",                       // Name
+                      logicWorld,                            // Mother volume
+                      false,                                 // No boolean operations
+                      0,                                     // Copy number
+                      checkOverlap);
+    logicEnvelope->SetVisAttributes(visAttributes);
+    fHcalRegion = EnvelopeRegion("hcal_region", logicEnvelope);
+
     // Absorber
     G4Box* solidAbsorber = new G4Box("hcal_absorber",                                       // Name
 			                         0.5 * absorberX, 0.5 * absorberY, 0.5 * absorberZ);    // Size
@@ -126,20 +149,20 @@ void DetectorConstruction::ConstructHCAL()
                                                           "hcal_absorber0");    // Name
 
     G4VPhysicalVolume* physiAbsorber = new G4PVPlacement(0,                   // No rotation
-                                                         G4ThreeVector(0, 0, absorberPositionZ0),
+                                                         G4ThreeVector(0, 0, absorberPositionZ0 - envelopePositionZ),
                                                          logicAbsorber0,      // Logical volume
                                                          "hcal_absorber0",    // Name
-                                                         logicWorld,          // Mother volume
+                                                         logicEnvelope,       // Mother volume
                                                          false,               // No boolean operations
                                                          -1,                  // Copy number
                                                          checkOverlap);
     for (G4int i_Layer = 0; i_Layer < nLayer; ++i_Layer)
     {
         physiAbsorber = new G4PVPlacement(0,                  // No rotation
-                                          G4ThreeVector(0, 0, (absorberPositionZ + i_Layer * thickness)),
+                                          G4ThreeVector(0, 0, (absorberPositionZ + i_Layer * thickness - envelopePositionZ)),
                                           logicAbsorber,      // Logical volume
                                           "hcal_absorber",    // Name
-                                          logicWorld,         // Mother volume
+                                          logicEnvelope,      // Mother volume
                                           false,              // No boolean operations
                                           -1,                 // Copy number
                                           checkOverlap);
@@ -175,21 +198,21 @@ void DetectorConstruction::ConstructHCAL()
                 physiCrystal = new G4PVPlacement(0,                                     // No rotation
                                                  G4ThreeVector(-0.5 * PCBX + (i_X + 0.5) * ESROutX,
                                                                -0.5 * PCBY + (i_Y + 0.5) * ESROutY,
-                                                               crystalPositionZ + i_Layer * thickness),
+                                                               crystalPositionZ + i_Layer * thickness - envelopePositionZ),
                                                  logicCrystal,                          // Logical volume
                                                  "hcal_psd",                            // Name
-                                                 logicWorld,                            // Mother volume
+                                                 logicEnvelope,                         // Mother volume
                                                  false,                                 // No boolean operations
-                                                 i_Layer * 100000 + i_X * 100 + i_Y,    // Copy number
+                                                 CellID::CopyNo(i_Layer, i_X, i_Y, nCellX, nCellY),  // Copy number
                                                  checkOverlap);
 
                 physiESR = new G4PVPlacement(0,             // No rotation
                                              G4ThreeVector(-0.5 * PCBX + (i_X + 0.5) * ESROutX,
                                                            -0.5 * PCBY + (i_Y + 0.5) * ESROutY,
-                                                           ESRPositionZ + i_Layer * thickness),
+                                                           ESRPositionZ + i_Layer * thickness - envelopePositionZ),
                                              logicESR,      // Logical volume
                                              "ESR",         // Name
-                                             logicWorld,    // Mother volume
+                                             logicEnvelope, // Mother volume
                                              false,         // No boolean operations
                                              -1,            // Copy number
                                              checkOverlap);
@@ -209,12 +232,18 @@ void DetectorConstruction::ConstructHCAL()
     for (G4int i_Layer = 0; i_Layer < nLayer; ++i_Layer)
     {
         physiPCB = new G4PVPlacement(0,             // No rotation
-                                     G4ThreeVector(0, 0, (PCBPositionZ + i_Layer * thickness)),
+                                     G4ThreeVector(0, 0, (PCBPositionZ + i_Layer * thickness - envelopePositionZ)),
                                      logicPCB,      // Logical volume
                                      "hcal_pcb",    // Name
-                                     logicWorld,    // Mother volume
+                                     logicEnvelope, // Mother volume
                                      false,         // No boolean operations
                                      -1,            // Copy number
                                      checkOverlap);
     }
-}
\ No newline at end of file
+
+    fHcalActive = logicCrystal;
+
+    // Sampling structure, handed to the shower library in ConstructSDandField to bin the frozen showers by their starting position within a layer
+    fHcalFront = ecal_length + absorberZ0 + gap_psd_abs0;
+    fHcalThickness = thickness;
+}
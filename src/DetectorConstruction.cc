@@ -11,19 +11,44 @@
 #include "G4Element.hh"
 #include "G4Material.hh"
 #include "G4GlobalMagFieldMessenger.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4SDManager.hh"
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "GFlashShowerModel.hh"
+#include "GFlashHitMaker.hh"
+#include "GFlashParticleBounds.hh"
+#include "GFlashSamplingShowerParameterisation.hh"
+#include <set>
 
 #include "DetectorConstruction.hh"
 #include "SteppingAction.hh"
+#include "EcalGFlashSD.hh"
+#include "ShowerLibrary.hh"
+#include "FrozenShowerModel.hh"
 
 DetectorConstruction::DetectorConstruction(Config* c)
  : G4VUserDetectorConstruction(),
-   config(c)
+   config(c),
+   fEcalRegion(0), fEcalCrystal(0), fEcalAbsorberMaterial(0), fEcalActiveMaterial(0),
+   fEcalAbsorberZ(0.0), fEcalActiveZ(0.0),
+   fGFlashModel(0), fGFlashHitMaker(0), fGFlashBounds(0), fGFlashParameterisation(0),
+   fHcalRegion(0), fHcalActive(0), fHcalFront(0.0), fHcalThickness(0.0), fFrozenShowerModel(0)
 {}
 
-DetectorConstruction::~DetectorConstruction() {}
+DetectorConstruction::~DetectorConstruction()
+{
+    delete fGFlashModel;
+    delete fGFlashHitMaker;
+    delete fGFlashBounds;
+    delete fGFlashParameterisation;
+    delete fFrozenShowerModel;
+}
 
 G4VPhysicalVolume* DetectorConstruction::Construct()
 {
+    RunSummary::Scope scope(config->GetSummary(), "geometry");
     visAttributes = new G4VisAttributes(G4Colour(0.9, 0.0, 0.0));
     visAttributes -> SetVisibility(false);
 
@@ -47,6 +72,47 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
     return physiWorld;
 }
 
+void DetectorConstruction::ConstructSDandField()
+{
+    // Frozen showers from the library for low-energy e+/e-/gamma in the HCAL envelope; the geometry itself never needs the library
+    ShowerLibrary* library = ShowerLibrary::Instance();
+    if (library)
+        library->SetGeometry(fHcalRegion, fHcalActive, fHcalFront, fHcalThickness);
+    if (fHcalRegion && library && library->IsLoaded() && !fFrozenShowerModel)
+        fFrozenShowerModel = new FrozenShowerModel("hcal_frozen", fHcalRegion, library);
+
+    // GFlash parameterised showers for e+/e- above the threshold in the ECAL envelope
+    if (!fEcalRegion || !config->conf["FastSim"]["gflash"].as<G4bool>(false) || fGFlashModel)
+        return;
+
+    G4double threshold = config->conf["FastSim"]["gflash_emin"].as<G4double>(1.0) * GeV;
+    G4cout << "GFlash is used in the ECAL for e+/e- above " << threshold / GeV << " GeV" << G4endl;
+
+    fGFlashParameterisation = new GFlashSamplingShowerParameterisation(fEcalAbsorberMaterial, fEcalActiveMaterial,
+                                                                       fEcalAbsorberZ, fEcalActiveZ);
+    fGFlashBounds = new GFlashParticleBounds();
+    fGFlashBounds->SetMinEneToParametrise(*G4Electron::ElectronDefinition(), threshold);
+    fGFlashBounds->SetMinEneToParametrise(*G4Positron::PositronDefinition(), threshold);
+    fGFlashHitMaker = new GFlashHitMaker();
+
+    fGFlashModel = new GFlashShowerModel("ecal_gflash", fEcalRegion);
+    fGFlashModel->SetParameterisation(*fGFlashParameterisation);
+    fGFlashModel->SetParticleBounds(*fGFlashBounds);
+    fGFlashModel->SetHitMaker(*fGFlashHitMaker);
+    fGFlashModel->SetFlagParamType(1);
+
+    // The energy spots are booked by this detector; full-simulation steps still go through SteppingAction.
+    // It covers every volume of the envelope, so that the spots in the absorber enter the energy balance.
+    EcalGFlashSD* sd = new EcalGFlashSD("ecal_gflash_sd", fEcalCrystal);
+    G4SDManager::GetSDMpointer()->AddNewDetector(sd);
+    G4LogicalVolume* envelope = *fEcalRegion->GetRootLogicalVolumeIterator();
+    std::set<G4LogicalVolume*> volumes = {envelope};
+    for (size_t i = 0; i < envelope->GetNoDaughters(); i++)
+        volumes.insert(envelope->GetDaughter(i)->GetLogicalVolume());
+    for (auto volume : volumes)
+        SetSensitiveDetector(volume, sd);
+}
+
 G4VPhysicalVolume* DetectorConstruction::ConstructWorld()
 {
     G4Material* Vacuum = G4NistManager::Instance()->FindOrBuildMaterial("G4_Galactic");
@@ -73,3 +139,15 @@ G4VPhysicalVolume* DetectorConstruction::ConstructWorld()
 
     return physiWorld;
 }
+
+G4Region* DetectorConstruction::EnvelopeRegion(const G4String& name, G4LogicalVolume* envelope)
+{
+    G4Region* region = G4RegionStore::GetInstance()->GetRegion(name, false);
+    if (!region)
+        region = new G4Region(name);
+    // The envelope of an earlier construction is no longer in the world
+    while (region->GetNumberOfRootVolumes() > 0)
+        region->RemoveRootLogicalVolume(*region->GetRootLogicalVolumeIterator());
+    region->AddRootLogicalVolume(envelope);
+    return region;
+}
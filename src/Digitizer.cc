@@ -0,0 +1,112 @@
+#include "Digitizer.hh"
+#include "TMath.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Value of an optional key, also when its whole section is missing
+    template <typename T>
+    T Get(const YAML::Node& conf, const char* section, const char* key, const T& fallback)
+    {
+        const YAML::Node node = conf[section];
+        return (node.IsDefined() && node.IsMap()) ? node[key].as<T>(fallback) : fallback;
+    }
+}
+
+Digitizer::Digitizer(const YAML::Node& conf, const double& threshold)
+ : fLayerThickness(30.0), fFront(EcalLength(conf)), fThreshold(threshold)
+{
+    fNCellX = conf["HCAL"]["nCellX"].as<int>();
+    fNCellY = conf["HCAL"]["nCellY"].as<int>();
+    fPitchX = conf["HCAL"]["CellWidthX"].as<double>() + conf["HCAL"]["GapX"].as<double>();
+    fPitchY = conf["HCAL"]["CellWidthY"].as<double>() + conf["HCAL"]["GapY"].as<double>();
+
+    // Defaults are the 30 layers of 42 x 5 strips of the prototype
+    fNStripX = Get<int>(conf, "ECAL", "nStripX", 42);
+    fNStripY = Get<int>(conf, "ECAL", "nStripY", 5);
+    fStripPitchX = Get<double>(conf, "ECAL", "StripWidth", 5.0);
+    fStripPitchY = Get<double>(conf, "ECAL", "StripLength", 45.0);
+    fStripThickness = Get<double>(conf, "ECAL", "StripThick", 2.0);
+    fEcalLayerThickness = fStripThickness + Get<double>(conf, "ECAL", "PCBThick", 2.0) + Get<double>(conf, "ECAL", "AbsorberThick", 2.8);
+}
+
+double Digitizer::EcalLength(const YAML::Node& conf)
+{
+    if (!Get<bool>(conf, "Geometry", "build_ECAL", false))
+        return 0.0;
+    double layer = Get<double>(conf, "ECAL", "StripThick", 2.0) + Get<double>(conf, "ECAL", "PCBThick", 2.0) + Get<double>(conf, "ECAL", "AbsorberThick", 2.8);
+    // At least the 300 mm of the original layout, so that the default HCAL does not move
+    return std::max(300.0, Get<int>(conf, "ECAL", "nLayer", 30) * layer);
+}
+
+ULong64_t Digitizer::Shift(const ULong64_t& cellID, const int& dx, const int& dy, const bool& mirrorX, const bool& mirrorY) const
+{
+    if (CellID::GetSubdetector(cellID) != CellID::kHcal)
+        return (dx == 0 && dy == 0 && !mirrorX && !mirrorY) ? cellID : CellID::kInvalid;
+    int x = (mirrorX ? fNCellX - 1 - CellID::GetX(cellID) : CellID::GetX(cellID)) + dx;
+    int y = (mirrorY ? fNCellY - 1 - CellID::GetY(cellID) : CellID::GetY(cellID)) + dy;
+    if (x < 0 || x >= fNCellX || y < 0 || y >= fNCellY)
+        return CellID::kInvalid;
+    return CellID::Encode(CellID::kHcal, CellID::GetLayer(cellID), x, y);
+}
+
+void Digitizer::Position(const ULong64_t& cellID, double& x, double& y, double& z) const
+{
+    int layer = CellID::GetLayer(cellID);
+    if (CellID::GetSubdetector(cellID) == CellID::kEcal)
+    {
+        // Strips are rotated by 90 degrees in odd layers
+        double across = (CellID::GetX(cellID) + 0.5 - 0.5 * fNStripX) * fStripPitchX;
+        double along = (CellID::GetY(cellID) + 0.5 - 0.5 * fNStripY) * fStripPitchY;
+        x = (layer % 2 == 0) ? across : along;
+        y = (layer % 2 == 0) ? along : across;
+        z = 0.5 * fStripThickness + layer * fEcalLayerThickness;
+        return;
+    }
+    x = (CellID::GetX(cellID) + 0.5 - 0.5 * fNCellX) * fPitchX;
+    y = (CellID::GetY(cellID) + 0.5 - 0.5 * fNCellY) * fPitchY;
+    z = fFront + fLayerThickness * layer;
+}
+
+double Digitizer::SiPM(const double& edep, TRandom& random) const
+{
+    Int_t sPix = 0;
+    sPix = random.Poisson(edep / 0.466 * 20);
+    sPix = 7396.0 * (1 - TMath::Exp(-sPix / 7284.0));
+    Double_t sChargeOutMean = sPix * 29.4;
+    Double_t sChargeOutSigma = sqrt(sPix * 5 * 5 + 3 * 3);
+    Double_t sChargeOut = -1;
+    while (sChargeOut < 0)
+        sChargeOut = random.Gaus(sChargeOutMean, sChargeOutSigma);
+    Double_t sAdc = -1;
+    while (sAdc < 0)
+        sAdc = random.Gaus(sChargeOut, 0.0002 * sChargeOut);
+    Double_t sMIP = sAdc / 29.4 * 0.05;
+    if (sMIP < 0.5)
+        return 0;
+    return sMIP * 0.466;
+}
+
+void Digitizer::Digitise(const std::unordered_map<ULong64_t, double>& cells, TRandom& random,
+                         std::vector<ULong64_t>& cellID, std::vector<double>& energy,
+                         std::vector<double>& x, std::vector<double>& y, std::vector<double>& z) const
+{
+    cellID.clear();
+    energy.clear();
+    x.clear();
+    y.clear();
+    z.clear();
+    for (auto i : cells)
+    {
+        if (i.second < fThreshold)
+            continue;
+        double cellX, cellY, cellZ;
+        Position(i.first, cellX, cellY, cellZ);
+        cellID.emplace_back(i.first);
+        energy.emplace_back(SiPM(i.second, random));
+        x.emplace_back(cellX);
+        y.emplace_back(cellY);
+        z.emplace_back(cellZ);
+    }
+}
@@ -0,0 +1,38 @@
+#include "G4GFlashSpot.hh"
+#include "G4EventManager.hh"
+#include "G4FastTrack.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+
+#include "EcalGFlashSD.hh"
+#include "EventAction.hh"
+
+EcalGFlashSD::EcalGFlashSD(const G4String& name, G4LogicalVolume* active)
+ : G4VSensitiveDetector(name), fActive(active)
+{}
+
+EcalGFlashSD::~EcalGFlashSD() {}
+
+G4bool EcalGFlashSD::ProcessHits(G4Step*, G4TouchableHistory*)
+{
+    return false;
+}
+
+G4bool EcalGFlashSD::ProcessHits(G4GFlashSpot* aSpot, G4TouchableHistory*)
+{
+    G4double edep = aSpot->GetEnergySpot()->GetEnergy();
+    if (edep <= 0.0)
+        return false;
+
+    G4VPhysicalVolume* volume = aSpot->GetTouchableHandle()->GetVolume();
+    G4bool active = (volume->GetLogicalVolume() == fActive);
+    G4double weight = aSpot->GetOriginatorTrack()->GetPrimaryTrack()->GetWeight();
+    EventAction* eventAction = static_cast<EventAction*>(G4EventManager::GetEventManager()->GetUserEventAction());
+    eventAction->AddEdep(weight * edep, active);
+    if (!active)
+        return false;
+
+    eventAction->AddWeight(edep, weight);
+    eventAction->AddHit(CellID::kEcal, volume->GetCopyNo(), weight * edep);
+    return true;
+}
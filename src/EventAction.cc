@@ -1,16 +1,42 @@
 #include "G4Event.hh"
+#include "G4UnitsTable.hh"
 #include <iomanip>
+#include <algorithm>
 #include <HistoManager.hh>
 #include <TTree.h>
+#include <TFile.h>
 #include "RunAction.hh"
 
 #include "EventAction.hh"
+#include "ShowerLibrary.hh"
+#include "SteppingAction.hh"
+#include "ResourceUsage.hh"
+#include "PerfCounters.hh"
+#include "ProgressMetrics.hh"
+#include "Trace.hh"
 //#include "EventMessenger.hh"
 
 EventAction::EventAction(HistoManager* histo, Config* c)
  : G4UserEventAction(),
    fEventEdep(0), fPrintModulo(10000), fDecayChain(), fHistoManager_Event(histo), config(c)
 {
+    fCheckpoint = config->conf["Global"]["checkpoint"].as<G4int>(0);
+    fSaveRaw = config->conf["Global"]["saveraw"].as<G4bool>(false);
+    fDigitizer = new Digitizer(config->conf);
+    fStepStream = StepStream::Instance();
+    fCopies = config->conf["Augment"]["copies"].as<G4int>(0);
+    fMargin = config->conf["Augment"]["margin"].as<G4int>(1);
+    fMirror = config->conf["Augment"]["mirror"].as<G4bool>(false);
+    // Shifting the HCAL cells alone would break showers starting in the ECAL
+    if (fCopies > 0 && config->conf["Geometry"]["build_ECAL"].as<G4bool>())
+    {
+        G4cout << "Event augmentation only applies to the HCAL alone, and is switched off." << G4endl;
+        fCopies = 0;
+    }
+    fNLocal = fNRoulette = fNKilledTracks = 0;
+    fWeightedEdep = fUnweightedEdep = 0.0;
+    fCpuStart = 0.0;
+    fStepStart = 0;
     fGParticleSource = new G4GeneralParticleSource();
 //    eventmanager->SetVerboseLevel(config->conf["Verbose"]["event"].as<int>());
 //    fHistoManager_Event = new HistoManager();
@@ -20,164 +46,231 @@ EventAction::EventAction(HistoManager* histo, Config* c)
 EventAction::~EventAction()
 {
     delete fGParticleSource;
+    delete fDigitizer;
 //    delete fHistoManager_Event;
 //    delete fEventMessenger;
 }
 
-void EventAction::BeginOfEventAction(const G4Event*)
+void EventAction::BeginOfEventAction(const G4Event* evt)
 {
+    CALO_TRACE_SCOPE("BeginOfEventAction");
+#ifdef CALO_ALLOC_COUNT
+    // The buffers have grown to their working size
+    if (evt->GetEventID() == AllocationCounter::kWarmUp)
+        AllocationCounter::Reset();
+#endif
     fStepTag = 0;
 //    G4cout << "....................66666666666666666666...................." << G4endl;
     fDecayChain = " ";
+    fNLocal = fNRoulette = fNKilledTracks = 0;
+    fWeightedEdep = fUnweightedEdep = 0.0;
+    fEventStart = std::chrono::steady_clock::now();
+    fCpuStart = ResourceUsage::CpuTime();
+    fStepStart = SteppingAction::Instance() ? SteppingAction::Instance()->GetStepCount() : 0;
+    if (PerfCounters::Instance())
+        PerfCounters::Instance()->BeginOfEvent();
 //    fHistoManager_Event->fParticleInfo.reset();
 //    G4cout << "Begin of event" << G4endl;
 }
 
 void EventAction::EndOfEventAction(const G4Event* evt)
 {
+    CALO_TRACE_SCOPE("EndOfEventAction");
+    CALO_ALLOC_SCOPE("EndOfEventAction");
 //    G4cout << " >>>>>>>>>>>>>>>>> " << fHistoManager_Event->fParticleInfo.fPrimaryEnergy << " <<<<<<<<<<<<<<<" << G4endl;
 //    G4cout << "....................77777777777777777777...................." << G4endl;
-    G4int evtNb = evt->GetEventID();
-
-    G4int nCellX = config->conf["HCAL"]["nCellX"].as<G4int>();
-    G4int nCellY = config->conf["HCAL"]["nCellY"].as<G4int>();
-    G4double CellWidthX = config->conf["HCAL"]["CellWidthX"].as<G4double>();
-    G4double CellWidthY = config->conf["HCAL"]["CellWidthY"].as<G4double>();
-    G4double gapX = config->conf["HCAL"]["GapX"].as<G4double>();
-    G4double gapY = config->conf["HCAL"]["GapY"].as<G4double>();
+    G4long evtNb = config->GetFirstEvent() + evt->GetEventID();
 
-    G4double thick = 30.0;
+    // Digitisation has its own stream, also derived from (seed, event ID)
+    fDigiRandom.SetSeed(config->GetEventSeed(evtNb, 1) | 1);
 
     // Printing survey
     if (evtNb < 10 || (evtNb <= 100 && evtNb % 10 == 0) || (evtNb > 100 && evtNb <= 1000 && evtNb % 100 == 0) || (evtNb > 1000 && evtNb % 1000 == 0))
         G4cout << "Begin of event: " << std::setw(6) << evtNb << fDecayChain << G4endl << G4endl;
 
-    /*
-    for (auto i : fHistoManager_Event->fParticleInfo.fecal_mape)
+    FillHits(0, 0, false, false);
+//    G4cout << "End of event " << fHistoManager_Event->fParticleInfo.nTrack << " " << fHistoManager_Event->fParticleInfo.fTrackTime[0] << G4endl;
+ 
+    // Energy balance of the run
+    G4double primaryEnergy = 0.0;
+    for (G4int i = 0; i < evt->GetNumberOfPrimaryVertex(); i++)
+        for (G4PrimaryParticle* primary = evt->GetPrimaryVertex(i)->GetPrimary(); primary; primary = primary->GetNext())
+            primaryEnergy += primary->GetKineticEnergy();
+    RunAction* runAction = static_cast<RunAction*>(const_cast<G4UserRunAction*>(G4RunManager::GetRunManager()->GetUserRunAction()));
+    runAction->EnergyBalance(primaryEnergy, fHistoManager_Event->fParticleInfo.fEdepActive, fHistoManager_Event->fParticleInfo.fEdepPassive,
+                             fHistoManager_Event->fParticleInfo.fEdepLocal, fNLocal, fNRoulette);
+    fHistoManager_Event->fParticleInfo.fWeight = (fUnweightedEdep > 0.0) ? fWeightedEdep / fUnweightedEdep : 1.0;
+    runAction->BudgetCount(fNKilledTracks, evt->IsAborted());
+
+    // Latency of the event, up to the digitisation; the tree fill is left out
+    ParticleInfo& info = fHistoManager_Event->fParticleInfo;
+    info.fWallTime = GetWallTime();
+    info.fCpuTime = ResourceUsage::CpuTime() - fCpuStart;
+    info.fNSteps = SteppingAction::Instance() ? SteppingAction::Instance()->GetStepCount() - fStepStart : 0;
+    info.fNCells = info.fhit_mape.size();
+    if (PerfCounters::Instance())
     {
-        if (i.second < 0.1)
-            continue;
-        fHistoManager_Event->fParticleInfo.fecal_cellid.emplace_back(i.first);
-        fHistoManager_Event->fParticleInfo.fecal_celle.emplace_back(SiPMDigi(i.second));
-        G4int layer = i.first / 210;
-        G4int m = (i.first % 210) / 42;
-        G4int n = (i.first % 210) % 42;
-        G4double x = 0.0;
-        G4double y = 0.0;
-        G4double z = 0.0;
-        if (layer % 2 == 0)
-        {
-            x = -41.0 * 5.0 * 0.5 + n * 5.0;
-            y = -4.0 * 45.0 * 0.5 + m * 45.0;
-        }
-        else
+        PerfCounters::Sample counts = PerfCounters::Instance()->EndOfEvent(info.fNSteps);
+        info.fCycles = counts.fCount[PerfCounters::kCycles];
+        info.fInstructions = counts.fCount[PerfCounters::kInstructions];
+        info.fCacheMisses = counts.fCount[PerfCounters::kCacheMisses];
+        info.fBranchMisses = counts.fCount[PerfCounters::kBranchMisses];
+    }
+    if (runAction->EventLatency(info.fWallTime, info.fCpuTime, info.fNSteps, info.fNCells))
+        DumpSlowEvent(evt);
+
+    {
+        CALO_TRACE_SCOPE("TTree::Fill");
+        fHistoManager_Event->fNtuple->Fill();
+    }
+    Augment(evtNb);
+    if (fStepStream)
+        fStepStream->EndOfEvent();
+    if (ProgressMetrics::Instance())
+        ProgressMetrics::Instance()->EndOfEvent(info.fNSteps, fHistoManager_Event->fRootFile->GetBytesWritten());
+    if (ShowerLibrary::Instance())
+        ShowerLibrary::Instance()->EndOfEvent();
+
+    // Periodic checkpoints, and on request of the batch system
+    G4int signal = Config::PendingSignal();
+    if ((fCheckpoint > 0 && (evtNb + 1) % fCheckpoint == 0) || signal != 0)
+        fHistoManager_Event->checkpoint(evtNb + 1);
+    if (signal == SIGTERM)
+    {
+        G4cout << "SIGTERM received, stopping after event " << evtNb << G4endl;
+        G4RunManager::GetRunManager()->AbortRun(true);
+    }
+    Config::ClearSignal();
+}
+
+void EventAction::FillHits(const G4int& dx, const G4int& dy, const G4bool& mirrorX, const G4bool& mirrorY)
+{
+    ParticleInfo& info = fHistoManager_Event->fParticleInfo;
+    const std::unordered_map<ULong64_t, G4double>* cells = &info.fhit_mape;
+
+    // Mirrored and shifted by whole cells for the augmented copies
+    std::unordered_map<ULong64_t, G4double> shifted;
+    if (dx != 0 || dy != 0 || mirrorX || mirrorY)
+    {
+        for (auto i : info.fhit_mape)
         {
-            x = -4.0 * 45.0 * 0.5 + m * 45.0;
-            y = -41.0 * 5.0 * 0.5 + n * 5.0;
+            ULong64_t cellID = fDigitizer->Shift(i.first, dx, dy, mirrorX, mirrorY);
+            if (cellID != CellID::kInvalid)
+                shifted[cellID] += i.second;
         }
-        z = 1.0 + layer * (2.0 + 2.0 + 2.8);
-        fHistoManager_Event->fParticleInfo.fecal_cellx.emplace_back(x);
-        fHistoManager_Event->fParticleInfo.fecal_celly.emplace_back(y);
-        fHistoManager_Event->fParticleInfo.fecal_cellz.emplace_back(z);
+        cells = &shifted;
     }
-    */
 
-    for (auto i : fHistoManager_Event->fParticleInfo.fhcal_mape)
+    CALO_TRACE_SCOPE("Digitise");
+    fDigitizer->Digitise(*cells, fDigiRandom, info.fhit_cellid, info.fhit_energy, info.fhit_x, info.fhit_y, info.fhit_z);
+
+    // Deposits before digitisation, for calo-overlay
+    if (fSaveRaw)
     {
-//        fHistoManager_Event->fParticleInfo.fhcal_celle_nodigi.emplace_back(i.second);
-        if (i.second < 0.1)
-        	continue;
-        fHistoManager_Event->fParticleInfo.fhcal_cellid.emplace_back(i.first);
-        fHistoManager_Event->fParticleInfo.fhcal_celle.emplace_back(SiPMDigi(i.second));
-        G4double x = (i.first % 100000) / 100;
-        G4double y = (i.first % 100);
-        G4double layer = i.first / 100000;
-        fHistoManager_Event->fParticleInfo.fhcal_cellx.emplace_back((x + 0.5 - 0.5 * nCellX) * (CellWidthX + gapX));
-        fHistoManager_Event->fParticleInfo.fhcal_celly.emplace_back((y + 0.5 - 0.5 * nCellY) * (CellWidthY + gapY));
-        fHistoManager_Event->fParticleInfo.fhcal_cellz.emplace_back(thick * layer);
+        info.fraw_cellid.clear();
+        info.fraw_energy.clear();
+        for (auto i : *cells)
+        {
+            info.fraw_cellid.emplace_back(i.first);
+            info.fraw_energy.emplace_back(i.second);
+        }
     }
-//    G4cout << "End of event " << fHistoManager_Event->fParticleInfo.nTrack << " " << fHistoManager_Event->fParticleInfo.fTrackTime[0] << G4endl;
- 
-    fHistoManager_Event->fNtuple->Fill();
 }
 
-/*
-void EventAction::AddEcalHit(const G4int& copyNo, const G4double& edep, const G4double& time, const G4int& pdgid, const G4int& trackid)
+void EventAction::Augment(const G4long& evtNb)
 {
-//    fHistoManager_Event->fParticleInfo.fecal_psdid.emplace_back(copyNo);
-//    fHistoManager_Event->fParticleInfo.fecal_energy.emplace_back(edep);
-//    fHistoManager_Event->fParticleInfo.fecal_pdgid.emplace_back(pdgid);
-//    fHistoManager_Event->fParticleInfo.fecal_trackid.emplace_back(trackid);
-//    fHistoManager_Event->fParticleInfo.fecal_time.emplace_back(time);
-
-    G4int layer=copyNo / 210;
-    //G4cout << copyNo << " " << layer << G4endl;
-    G4int m = (copyNo % 210) / 42;
-    G4int n = (copyNo % 210) % 42;
-    G4double x = 0.0;
-    G4double y = 0.0;
-    G4double z = 0.0;
-    if (layer % 2 == 0)
+    if (fCopies <= 0)
+        return;
+
+    G4int nCellX = fDigitizer->GetNCellX();
+    G4int nCellY = fDigitizer->GetNCellY();
+    ParticleInfo& info = fHistoManager_Event->fParticleInfo;
+    if (info.fhit_mape.empty())
+        return;
+
+    // Bounding box of all deposits, which must stay at least fMargin cells from the edges
+    G4int xMin = nCellX, xMax = -1, yMin = nCellY, yMax = -1;
+    for (auto i : info.fhit_mape)
     {
-        x = -41.0 * 5.0 * 0.5 + n * 5.0;
-        y = -4.0 * 45.0 * 0.5 + m * 45.0;
+        G4int x = CellID::GetX(i.first);
+        G4int y = CellID::GetY(i.first);
+        xMin = std::min(xMin, x);
+        xMax = std::max(xMax, x);
+        yMin = std::min(yMin, y);
+        yMax = std::max(yMax, y);
     }
-    else
+
+    // Offsets come from a third stream, so that the original event does not depend on the number of copies
+    fAugmentRandom.SetSeed(config->GetEventSeed(evtNb, 2) | 1);
+    for (G4int copy = 1; copy <= fCopies; copy++)
     {
-        x = -4.0 * 45.0 * 0.5 + m * 45.0;
-        y = -41.0 * 5.0 * 0.5 + n * 5.0;
+        G4bool mirrorX = fMirror && fAugmentRandom.Rndm() < 0.5;
+        G4bool mirrorY = fMirror && fAugmentRandom.Rndm() < 0.5;
+        G4int x0 = mirrorX ? nCellX - 1 - xMax : xMin, x1 = mirrorX ? nCellX - 1 - xMin : xMax;
+        G4int y0 = mirrorY ? nCellY - 1 - yMax : yMin, y1 = mirrorY ? nCellY - 1 - yMin : yMax;
+        G4int dxMin = fMargin - x0, dxMax = nCellX - 1 - fMargin - x1;
+        G4int dyMin = fMargin - y0, dyMax = nCellY - 1 - fMargin - y1;
+        // The shower is not contained, or cannot move: only the original is kept
+        if (dxMin > dxMax || dyMin > dyMax || (!fMirror && dxMin == dxMax && dyMin == dyMax && dxMin == 0 && dyMin == 0))
+            break;
+
+        // A copy identical to the original is drawn again
+        G4int dx = 0, dy = 0;
+        for (G4int trial = 0; trial < 10 && dx == 0 && dy == 0 && !mirrorX && !mirrorY; trial++)
+        {
+            dx = dxMin + static_cast<G4int>(fAugmentRandom.Integer(dxMax - dxMin + 1));
+            dy = dyMin + static_cast<G4int>(fAugmentRandom.Integer(dyMax - dyMin + 1));
+        }
+        if (dx == 0 && dy == 0 && !mirrorX && !mirrorY)
+            continue;
+        FillHits(dx, dy, mirrorX, mirrorY);
+        info.fCopyID = copy;
+        CALO_TRACE_SCOPE("TTree::Fill");
+        fHistoManager_Event->fNtuple->Fill();
     }
-    z = 1.0 + layer * (2.0 + 2.0 + 2.8);
-//    fHistoManager_Event->fParticleInfo.fecal_x.emplace_back(x);
-//    fHistoManager_Event->fParticleInfo.fecal_y.emplace_back(y);
-//    fHistoManager_Event->fParticleInfo.fecal_z.emplace_back(z);
-    fHistoManager_Event->fParticleInfo.fecal_mape[copyNo] += edep;
+    info.fCopyID = 0;
 }
-*/
 
+void EventAction::DumpSlowEvent(const G4Event* evt)
+{
+    const ParticleInfo& info = fHistoManager_Event->fParticleInfo;
+    G4cout << "Slow event " << info.fEventID << " (seed " << info.fEventSeed << "): " << info.fWallTime << " s wall, "
+           << info.fCpuTime << " s CPU, " << info.fNSteps << " steps, " << info.fNCells << " cells" << G4endl;
+    for (G4int i = 0; i < evt->GetNumberOfPrimaryVertex(); i++)
+    {
+        const G4PrimaryVertex* vertex = evt->GetPrimaryVertex(i);
+        for (G4PrimaryParticle* primary = vertex->GetPrimary(); primary; primary = primary->GetNext())
+            G4cout << "  " << (primary->GetG4code() ? primary->GetG4code()->GetParticleName() : G4String("PDG ") + std::to_string(primary->GetPDGcode()))
+                   << " " << G4BestUnit(primary->GetKineticEnergy(), "Energy") << " at " << G4BestUnit(vertex->GetPosition(), "Length")
+                   << " along " << primary->GetMomentumDirection() << G4endl;
+    }
+    G4cout << "  replay with --replay " << info.fEventID << G4endl;
+}
 
-void EventAction::AddHcalHit(const G4int& copyNo, const G4double& edep, const G4double& time, const G4int& pdgid, const G4int& trackid)
+void EventAction::ExceedBudget(const Budget& budget, const G4Track* track)
 {
-    /*
-    G4int nCellX = config->conf["HCAL"]["nCellX"].as<G4int>();
-    G4int nCellY = config->conf["HCAL"]["nCellY"].as<G4int>();
-    G4double CellWidthX = config->conf["HCAL"]["CellWidthX"].as<G4double>();
-    G4double CellWidthY = config->conf["HCAL"]["CellWidthY"].as<G4double>();
-    G4double gapX = config->conf["HCAL"]["GapX"].as<G4double>();
-    G4double gapY = config->conf["HCAL"]["GapY"].as<G4double>();
-
-    G4double thick = 30.0;
-
-    fHistoManager_Event->fParticleInfo.fhcal_psdid.emplace_back(copyNo);
-    fHistoManager_Event->fParticleInfo.fhcal_energy.emplace_back(edep);
-    fHistoManager_Event->fParticleInfo.fhcal_pdgid.emplace_back(pdgid);
-    fHistoManager_Event->fParticleInfo.fhcal_trackid.emplace_back(trackid);
-    fHistoManager_Event->fParticleInfo.fhcal_time.emplace_back(time);
-    G4double x = (copyNo % 100000) / 100;
-    G4double y = (copyNo % 100);
-    G4double layer = copyNo / 100000;
-    fHistoManager_Event->fParticleInfo.fhcal_x.emplace_back((x + 0.5 - 0.5 * nCellX) * (CellWidthX + gapX));
-    fHistoManager_Event->fParticleInfo.fhcal_y.emplace_back((y + 0.5 - 0.5 * nCellY) * (CellWidthY + gapY));
-    fHistoManager_Event->fParticleInfo.fhcal_z.emplace_back(thick * layer);
-    */
-    fHistoManager_Event->fParticleInfo.fhcal_mape[copyNo] += edep;
+    ParticleInfo& info = fHistoManager_Event->fParticleInfo;
+    // An aborted event is only logged once
+    if (budget == kEventWall && (info.fStatus & kEventWall))
+        return;
+    info.fStatus |= budget;
+
+    G4cout << "Event " << info.fEventID << " (seed " << info.fEventSeed << "): ";
+    if (budget == kEventWall)
+    {
+        G4cout << "aborted after " << GetWallTime() << " s";
+    }
+    else
+    {
+        fNKilledTracks++;
+        G4cout << "track " << track->GetTrackID() << " (" << track->GetDefinition()->GetParticleName() << ", "
+               << G4BestUnit(track->GetKineticEnergy(), "Energy") << ") killed after " << track->GetCurrentStepNumber()
+               << " steps at " << G4BestUnit(track->GetGlobalTime(), "Time");
+    }
+    G4cout << "; replay with --replay " << info.fEventID << G4endl;
 }
 
-Double_t EventAction::SiPMDigi(const Double_t& edep) const
+Double_t EventAction::SiPMDigi(const Double_t& edep)
 {
-    Int_t sPix = 0;
-    sPix = gRandom->Poisson(edep / 0.466 * 20);
-    sPix = 7396.0 * (1 - TMath::Exp(-sPix / 7284.0));
-    Double_t sChargeOutMean = sPix * 29.4;
-    Double_t sChargeOutSigma = sqrt(sPix * 5 * 5 + 3 * 3);
-    Double_t sChargeOut = -1;
-    while (sChargeOut < 0)
-        sChargeOut = gRandom->Gaus(sChargeOutMean, sChargeOutSigma);
-    Double_t sAdc = -1;
-    while (sAdc < 0)
-        sAdc = gRandom->Gaus(sChargeOut, 0.0002 * sChargeOut);
-    Double_t sMIP = sAdc / 29.4 * 0.05;
-    if (sMIP < 0.5)
-        return 0;
-    return sMIP * 0.466;
+    return fDigitizer->SiPM(edep, fDigiRandom);
 }
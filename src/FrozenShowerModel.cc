@@ -0,0 +1,84 @@
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "G4Gamma.hh"
+#include "G4Navigator.hh"
+#include "G4TransportationManager.hh"
+#include "G4EventManager.hh"
+#include "G4FastTrack.hh"
+#include "G4FastStep.hh"
+#include "G4PhysicalConstants.hh"
+#include "Randomize.hh"
+#include <algorithm>
+
+#include "FrozenShowerModel.hh"
+#include "ShowerLibrary.hh"
+#include "EventAction.hh"
+
+FrozenShowerModel::FrozenShowerModel(const G4String& name, G4Region* region, ShowerLibrary* library)
+ : G4VFastSimulationModel(name, region),
+   fLibrary(library), fNavigator(new G4Navigator())
+{}
+
+FrozenShowerModel::~FrozenShowerModel()
+{
+    delete fNavigator;
+}
+
+G4bool FrozenShowerModel::IsApplicable(const G4ParticleDefinition& particle)
+{
+    return &particle == G4Electron::Definition() || &particle == G4Positron::Definition() || &particle == G4Gamma::Definition();
+}
+
+G4bool FrozenShowerModel::ModelTrigger(const G4FastTrack& fastTrack)
+{
+    const G4Track* track = fastTrack.GetPrimaryTrack();
+    std::tuple<G4int, G4int, G4int> bin;
+    return fLibrary->GetBin(track->GetDefinition(), track->GetKineticEnergy(), track->GetPosition().z(), bin)
+        && fLibrary->HasShowers(bin);
+}
+
+void FrozenShowerModel::DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep)
+{
+    const G4Track* track = fastTrack.GetPrimaryTrack();
+    G4double energy = track->GetKineticEnergy();
+    std::tuple<G4int, G4int, G4int> bin;
+    fLibrary->GetBin(track->GetDefinition(), energy, track->GetPosition().z(), bin);
+    const FrozenShower* shower = fLibrary->Draw(bin);
+
+    fastStep.KillPrimaryTrack();
+    fastStep.ProposePrimaryTrackPathLength(0.0);
+
+    // Same time window as SteppingAction for the hits; the energy balance takes the whole shower
+    G4bool inTime = (track->GetGlobalTime() <= 150.0);
+
+    // The transverse axes are rotated randomly around the direction
+    G4ThreeVector direction = track->GetMomentumDirection();
+    G4ThreeVector t1 = direction.orthogonal().unit();
+    t1.rotate(twopi * G4UniformRand(), direction);
+    G4ThreeVector t2 = direction.cross(t1);
+    G4double weight = track->GetWeight();
+    G4double scale = energy / shower->fEnergy;
+
+    if (!fNavigator->GetWorldVolume())
+        fNavigator->SetWorldVolume(G4TransportationManager::GetTransportationManager()->GetNavigatorForTracking()->GetWorldVolume());
+
+    EventAction* eventAction = static_cast<EventAction*>(G4EventManager::GetEventManager()->GetUserEventAction());
+    G4double visible = 0.0;
+    for (const auto& spot : shower->fSpots)
+    {
+        G4ThreeVector position = track->GetPosition() + spot.fL * direction + spot.fT1 * t1 + spot.fT2 * t2;
+        G4VPhysicalVolume* volume = fNavigator->LocateGlobalPointAndSetup(position, nullptr, false, true);
+        if (!volume || volume->GetLogicalVolume() != fLibrary->GetActive())
+            continue;
+        G4double edep = scale * spot.fE;
+        visible += edep;
+        if (!inTime)
+            continue;
+        eventAction->AddWeight(edep, weight);
+        eventAction->AddHit(CellID::kHcal, volume->GetCopyNo(), weight * edep);
+    }
+
+    // The library keeps the visible deposits in the tiles only (after Birks' law); the rest of the energy is counted as passive
+    eventAction->AddEdep(weight * visible, true);
+    eventAction->AddEdep(weight * std::max(0.0, energy - visible), false);
+}
@@ -1,10 +1,19 @@
 #include "HistoManager.hh"
+#include "PerfCounters.hh"
+#include "Trace.hh"
 #include "G4UnitsTable.hh"
+#include "Randomize.hh"
 #include <TTree.h>
 #include <TFile.h>
+#include <TObjString.h>
+#include <TParameter.h>
+#include <TBranch.h>
+#include <memory>
+#include <sstream>
+#include <unistd.h>
 
-HistoManager::HistoManager(const char* foutname, const G4bool& savegeo)
-  : fRootFile(0), fNtuple(0), fSaveGeo(savegeo)
+HistoManager::HistoManager(const char* foutname, const G4bool& savegeo, const G4bool& saveraw, const G4bool& saveevents)
+  : fRootFile(0), fNtuple(0), fRunTree(0), fSaveGeo(savegeo), fSaveRaw(saveraw), fSaveEvents(saveevents), fResume(false)
 {
     fOutName = foutname;
 }
@@ -14,11 +23,35 @@ HistoManager::~HistoManager()
     delete G4AnalysisManager::Instance();
 }
 
+template <typename T>
+void HistoManager::Attach(TTree* tree, const char* name, T* address, const char* leaflist)
+{
+    if (tree->GetBranch(name))
+        tree->SetBranchAddress(name, address);
+    else if (leaflist)
+        tree->Branch(name, address, leaflist);
+    else
+        tree->Branch(name, address);
+}
+
 void HistoManager::book()
 {
-    G4cout << "----------> Creating ROOT file < ----------" << G4endl << G4endl;
-    fRootFile = new TFile(fOutName.c_str(), "RECREATE");
-    fNtuple = new TTree("Calib_Hit", "MC events");
+    if (fResume)
+    {
+        G4cout << "----------> Opening ROOT file to continue <----------" << G4endl << G4endl;
+        fRootFile = new TFile(fOutName.c_str(), "UPDATE");
+        fRootFile->GetObject("Calib_Hit", fNtuple);
+        fRootFile->GetObject("RunInfo", fRunTree);
+    }
+    else
+    {
+        G4cout << "----------> Creating ROOT file < ----------" << G4endl << G4endl;
+        // Unlink first: an old output may be a read-only hard link into the sample cache
+        std::remove(fOutName.c_str());
+        fRootFile = new TFile(fOutName.c_str(), "RECREATE");
+    }
+    if (!fNtuple)
+        fNtuple = new TTree("Calib_Hit", "MC events");
 //    fNtuple = new TTree("Calib_Hit", "MC events of " + G4BestUnit(config->conf["Source"]["energy"].as<G4double>(), "Energy") + " " + config->conf["Source"]["particle"].as<G4String>());
 
     /*
@@ -52,20 +85,57 @@ void HistoManager::book()
     fNtuple->Branch("hcal_celly",          &fParticleInfo.fhcal_celly);
     fNtuple->Branch("hcal_cellz",          &fParticleInfo.fhcal_cellz);
     */
-    fNtuple->Branch("CellID",              &fParticleInfo.fhcal_cellid);
+    Attach(fNtuple, "EventID",     &fParticleInfo.fEventID,   "EventID/L");
+    Attach(fNtuple, "EventSeed",   &fParticleInfo.fEventSeed, "EventSeed/l");
+    Attach(fNtuple, "CellID",      &fParticleInfo.fhit_cellid);
 //    fNtuple->Branch("Hit_Energy_nodigi",   &fParticleInfo.fhcal_celle_nodigi);
-    fNtuple->Branch("Hit_Energy",          &fParticleInfo.fhcal_celle);
-    fNtuple->Branch("Hit_X",               &fParticleInfo.fhcal_cellx);
-    fNtuple->Branch("Hit_Y",               &fParticleInfo.fhcal_celly);
-    fNtuple->Branch("Hit_Z",               &fParticleInfo.fhcal_cellz);
+    Attach(fNtuple, "Hit_Energy",  &fParticleInfo.fhit_energy);
+    Attach(fNtuple, "Hit_X",       &fParticleInfo.fhit_x);
+    Attach(fNtuple, "Hit_Y",       &fParticleInfo.fhit_y);
+    Attach(fNtuple, "Hit_Z",       &fParticleInfo.fhit_z);
+    Attach(fNtuple, "Edep_Active",  &fParticleInfo.fEdepActive,  "Edep_Active/D");
+    Attach(fNtuple, "Edep_Passive", &fParticleInfo.fEdepPassive, "Edep_Passive/D");
+    Attach(fNtuple, "Edep_Local",   &fParticleInfo.fEdepLocal,   "Edep_Local/D");
+    Attach(fNtuple, "Weight",       &fParticleInfo.fWeight,      "Weight/D");
+    Attach(fNtuple, "Status",       &fParticleInfo.fStatus,      "Status/I");
+    Attach(fNtuple, "CopyID",       &fParticleInfo.fCopyID,      "CopyID/I");
+    if (fSaveRaw)
+    {
+        Attach(fNtuple, "Raw_CellID", &fParticleInfo.fraw_cellid);
+        Attach(fNtuple, "Raw_Energy", &fParticleInfo.fraw_energy);
+    }
+    if (fSaveEvents)
+    {
+        Attach(fNtuple, "Event_WallTime", &fParticleInfo.fWallTime, "Event_WallTime/D");
+        Attach(fNtuple, "Event_CpuTime",  &fParticleInfo.fCpuTime,  "Event_CpuTime/D");
+        Attach(fNtuple, "Event_Steps",    &fParticleInfo.fNSteps,   "Event_Steps/L");
+        Attach(fNtuple, "Event_Cells",    &fParticleInfo.fNCells,   "Event_Cells/I");
+        if (PerfCounters::Instance() && PerfCounters::Instance()->IsAvailable())
+        {
+            Attach(fNtuple, "Event_Cycles",       &fParticleInfo.fCycles,       "Event_Cycles/D");
+            Attach(fNtuple, "Event_Instructions", &fParticleInfo.fInstructions, "Event_Instructions/D");
+            Attach(fNtuple, "Event_CacheMisses",  &fParticleInfo.fCacheMisses,  "Event_CacheMisses/D");
+            Attach(fNtuple, "Event_BranchMisses", &fParticleInfo.fBranchMisses, "Event_BranchMisses/D");
+        }
+    }
 //    fNtuple->Branch("Energy",              &fParticleInfo.fhcal_energy);
 //    fNtuple->Branch("X",                   &fParticleInfo.fhcal_x);
 //    fNtuple->Branch("Y",                   &fParticleInfo.fhcal_y);
 //    fNtuple->Branch("Z",                   &fParticleInfo.fhcal_z);
 //    fNtuple->Branch("Time",                &fParticleInfo.fhcal_time);
+
+    if (!fRunTree)
+        fRunTree = new TTree("RunInfo", "Run provenance");
+    Attach(fRunTree, "ConfigHash",  &fRunInfo.fConfigHash,  "ConfigHash/l");
+    Attach(fRunTree, "Seed",        &fRunInfo.fSeed,        "Seed/L");
+    Attach(fRunTree, "Shard",       &fRunInfo.fShard,       "Shard/I");
+    Attach(fRunTree, "FirstEvent",  &fRunInfo.fFirstEvent,  "FirstEvent/L");
+    Attach(fRunTree, "NEvents",     &fRunInfo.fNEvents,     "NEvents/L");
+    Attach(fRunTree, "NEntries",    &fRunInfo.fNEntries,    "NEntries/L");
+    Attach(fRunTree, "EntryOffset", &fRunInfo.fEntryOffset, "EntryOffset/L");
 }
 
-void HistoManager::save()
+void HistoManager::save(const Long64_t& nextEvent)
 {
     if (fSaveGeo)
     {
@@ -75,7 +145,167 @@ void HistoManager::save()
         std::remove("cepc-calo.gdml");
     }
 
+    // A continued run also counts the events of the interrupted one, which start at its FirstEvent
+    fRunInfo.fNEvents = nextEvent - fRunInfo.fFirstEvent;
+    fRunInfo.fNEntries = fNtuple->GetEntries() - fRunInfo.fEntryOffset;
+    fRunTree->Fill();
+    checkpoint(nextEvent);
+
     fNtuple->Write("", TObject::kOverwrite);
+    fRunTree->Write("", TObject::kOverwrite);
     fRootFile->Close();
     G4cout << "----------> Closing ROOT file <----------" << G4endl << G4endl;
 }
+
+Long64_t HistoManager::GetBasketBytes() const
+{
+    Long64_t bytes = 0;
+    TIter next(fNtuple->GetListOfBranches());
+    while (TBranch* branch = static_cast<TBranch*>(next()))
+        bytes += branch->GetBasketSize();
+    return bytes;
+}
+
+void HistoManager::checkpoint(const Long64_t& nextEvent)
+{
+    CALO_TRACE_SCOPE("checkpoint");
+    TDirectory* dir = fRootFile->GetDirectory("checkpoint");
+    if (!dir)
+        dir = fRootFile->mkdir("checkpoint");
+    dir->cd();
+
+    std::ostringstream engine;
+    CLHEP::HepRandom::getTheEngine()->put(engine);
+    TObjString(engine.str().c_str()).Write("Engine", TObject::kOverwrite);
+    TParameter<Long64_t>("NextEvent", nextEvent).Write("", TObject::kOverwrite);
+    TParameter<Long64_t>("Entries", fNtuple->GetEntries()).Write("", TObject::kOverwrite);
+    TParameter<Long64_t>("ConfigHash", fRunInfo.fConfigHash).Write("", TObject::kOverwrite);
+    TParameter<Long64_t>("Seed", fRunInfo.fSeed).Write("", TObject::kOverwrite);
+    fRootFile->cd();
+
+    // Baskets and tree header first, then the key list, so the file on disk is consistent up to here
+    CALO_TRACE_SCOPE("TFile::Flush");
+    fNtuple->AutoSave("SaveSelf");
+    fRootFile->Flush();
+}
+
+Long64_t HistoManager::restore(const std::uint64_t& configHash, G4long& seed, const G4String& source)
+{
+    std::unique_ptr<TFile> fin(TFile::Open(source.c_str(), "READ"));
+    TDirectory* dir = (fin && !fin->IsZombie()) ? fin->GetDirectory("checkpoint") : nullptr;
+    if (!dir)
+    {
+        G4cout << "No checkpoint found in " << source << G4endl;
+        return -1;
+    }
+
+    TParameter<Long64_t>* next = nullptr;
+    TParameter<Long64_t>* entries = nullptr;
+    TParameter<Long64_t>* hash = nullptr;
+    TParameter<Long64_t>* savedSeed = nullptr;
+    TObjString* engine = nullptr;
+    dir->GetObject("NextEvent", next);
+    dir->GetObject("Entries", entries);
+    dir->GetObject("ConfigHash", hash);
+    dir->GetObject("Seed", savedSeed);
+    dir->GetObject("Engine", engine);
+    if (!next || !entries || !hash || !savedSeed || !engine)
+    {
+        G4cout << "Incomplete checkpoint in " << source << G4endl;
+        return -1;
+    }
+    if (static_cast<std::uint64_t>(hash->GetVal()) != configHash)
+    {
+        G4cout << "The checkpoint in " << source << " was written with a different configuration" << G4endl;
+        return -1;
+    }
+
+    std::istringstream engineState(engine->GetString().Data());
+    CLHEP::HepRandom::getTheEngine()->get(engineState);
+    seed = savedSeed->GetVal();
+
+    // A new file starts its own provenance at the next event
+    if (source != fOutName)
+    {
+        fRunInfo.fEntryOffset = 0;
+        fRunInfo.fFirstEvent = next->GetVal();
+        return next->GetVal();
+    }
+
+    if (access(source.c_str(), W_OK) != 0)
+    {
+        G4cout << source << " is read-only (taken from the sample cache?); write the new events into a sibling file" << G4endl;
+        return -1;
+    }
+
+    TTree* hits = nullptr;
+    fin->GetObject("Calib_Hit", hits);
+    if (!hits || hits->GetEntries() != entries->GetVal())
+    {
+        G4cout << "The tree in " << source << " does not match its checkpoint (" << entries->GetVal() << " events)" << G4endl;
+        return -1;
+    }
+
+    // The continued run starts after the runs already recorded in RunInfo
+    Long64_t covered = 0;
+    TTree* runs = nullptr;
+    fin->GetObject("RunInfo", runs);
+    if (runs)
+    {
+        // Files written before NEntries kept the entry count in NEvents
+        Long64_t nEntries = 0;
+        runs->SetBranchAddress(runs->GetBranch("NEntries") ? "NEntries" : "NEvents", &nEntries);
+        for (Long64_t i = 0; i < runs->GetEntries(); i++)
+        {
+            runs->GetEntry(i);
+            covered += nEntries;
+        }
+        runs->ResetBranchAddresses();
+    }
+    fRunInfo.fEntryOffset = covered;
+    // Augmented events have several entries, so the first event of the interrupted run is read from the tree
+    fRunInfo.fFirstEvent = next->GetVal();
+    if (entries->GetVal() > covered)
+    {
+        Long64_t firstEvent = 0;
+        hits->SetBranchAddress("EventID", &firstEvent);
+        hits->GetEntry(covered);
+        hits->ResetBranchAddresses();
+        fRunInfo.fFirstEvent = firstEvent;
+    }
+    fResume = true;
+    return next->GetVal();
+}
+
+G4bool HistoManager::findRun(const G4String& source, const Long64_t& event, RunInfo& run)
+{
+    std::unique_ptr<TFile> fin(TFile::Open(source.c_str(), "READ"));
+    TTree* runs = nullptr;
+    if (fin && !fin->IsZombie())
+        fin->GetObject("RunInfo", runs);
+    if (!runs)
+    {
+        G4cout << "No run provenance found in " << source << G4endl;
+        return false;
+    }
+
+    RunInfo entry;
+    runs->SetBranchAddress("ConfigHash", &entry.fConfigHash);
+    runs->SetBranchAddress("Seed", &entry.fSeed);
+    runs->SetBranchAddress("FirstEvent", &entry.fFirstEvent);
+    runs->SetBranchAddress("NEvents", &entry.fNEvents);
+    G4bool found = false;
+    for (Long64_t i = 0; i < runs->GetEntries() && !found; i++)
+    {
+        runs->GetEntry(i);
+        found = (event >= entry.fFirstEvent && event < entry.fFirstEvent + entry.fNEvents);
+    }
+    runs->ResetBranchAddresses();
+    if (!found)
+    {
+        G4cout << "No run of " << source << " simulated event " << event << G4endl;
+        return false;
+    }
+    run = entry;
+    return true;
+}
@@ -0,0 +1,187 @@
+#include "NavigationBenchmark.hh"
+#include "Config.hh"
+#include "ResourceUsage.hh"
+#include "G4Event.hh"
+#include "G4Track.hh"
+#include "G4ParticleTable.hh"
+#include "G4GeometryManager.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4SmartVoxelHeader.hh"
+#include "G4SmartVoxelStat.hh"
+#include "G4SystemOfUnits.hh"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+NavigationBenchmark::NavigationBenchmark(Config* c)
+ : config(c), fNSteps(0), fWallTime(0.0), fCpuTime(0.0)
+{
+    YAML::Node nav = config->conf["Navigation"];
+    std::istringstream particles(nav["particles"].as<std::string>("geantino chargedgeantino"));
+    std::string particle;
+    while (particles >> particle)
+        fParticles.emplace_back(particle);
+    fNRepeat = std::max(1, nav["repeat"].as<G4int>(10));
+    fNReport = nav["report"].as<G4int>(15);
+
+    // Square grid of starting points in the plane z, centred on the beam axis
+    G4int nX = std::max(1, nav["nX"].as<G4int>(9));
+    G4int nY = std::max(1, nav["nY"].as<G4int>(9));
+    G4double width = nav["width"].as<G4double>(720.0) * mm;
+    G4double z = nav["z"].as<G4double>(-100.0) * mm;
+    // Polar angles from 0 to thetaMax, each non-zero one with nPhi azimuths
+    G4int nTheta = std::max(1, nav["nTheta"].as<G4int>(4));
+    G4int nPhi = std::max(1, nav["nPhi"].as<G4int>(4));
+    G4double thetaMax = nav["thetaMax"].as<G4double>(30.0) * deg;
+
+    for (G4int i = 0; i < nX; i++)
+        for (G4int j = 0; j < nY; j++)
+        {
+            G4ThreeVector position(width * ((i + 0.5) / nX - 0.5), width * ((j + 0.5) / nY - 0.5), z);
+            fRays.emplace_back(position, G4ThreeVector(0, 0, 1));
+            for (G4int k = 1; k < nTheta; k++)
+                for (G4int l = 0; l < nPhi; l++)
+                {
+                    G4ThreeVector direction;
+                    direction.setRThetaPhi(1.0, thetaMax * k / (nTheta - 1), twopi * l / nPhi);
+                    fRays.emplace_back(position, direction);
+                }
+        }
+
+    fGun = new G4ParticleGun(1);
+    fGun->SetParticleEnergy(1 * GeV);
+}
+
+NavigationBenchmark::~NavigationBenchmark()
+{
+    delete fGun;
+}
+
+void NavigationBenchmark::SetUserActions(G4RunManager* runManager)
+{
+    runManager->SetUserAction(new Gun(this));
+    runManager->SetUserAction(new Timer(this));
+    runManager->SetUserAction(new Counter(this));
+}
+
+void NavigationBenchmark::Gun::GeneratePrimaries(G4Event* event)
+{
+    G4ParticleGun* gun = fBenchmark->fGun;
+    for (const auto& ray : fBenchmark->fRays)
+    {
+        gun->SetParticlePosition(ray.first);
+        gun->SetParticleMomentumDirection(ray.second);
+        gun->GeneratePrimaryVertex(event);
+    }
+}
+
+void NavigationBenchmark::Timer::BeginOfRunAction(const G4Run*)
+{
+    fBenchmark->fNSteps = 0;
+    fBenchmark->fWallTime = ResourceUsage::WallTime();
+    fBenchmark->fCpuTime = ResourceUsage::CpuTime();
+}
+
+void NavigationBenchmark::Timer::EndOfRunAction(const G4Run*)
+{
+    fBenchmark->fWallTime = ResourceUsage::WallTime() - fBenchmark->fWallTime;
+    fBenchmark->fCpuTime = ResourceUsage::CpuTime() - fBenchmark->fCpuTime;
+}
+
+void NavigationBenchmark::Counter::PostUserTrackingAction(const G4Track* track)
+{
+    fBenchmark->fNSteps += track->GetCurrentStepNumber();
+}
+
+void NavigationBenchmark::ReportVoxels()
+{
+    // The run manager closes the geometry again at the first run; closing it here gives its cost alone
+    G4GeometryManager* geometry = G4GeometryManager::GetInstance();
+    geometry->OpenGeometry();
+    G4double rss = ResourceUsage::RSS();
+    G4double start = ResourceUsage::CpuTime();
+    geometry->CloseGeometry(true, config->conf["Verbose"]["run"].as<G4int>() > 1);
+    G4double time = ResourceUsage::CpuTime() - start;
+    rss = ResourceUsage::RSS() - rss;
+
+    std::vector<G4SmartVoxelStat> stats;
+    for (auto volume : *G4LogicalVolumeStore::GetInstance())
+        if (volume->GetVoxelHeader())
+            stats.emplace_back(volume, volume->GetVoxelHeader(), 0.0, 0.0);
+    std::vector<const G4SmartVoxelStat*> sorted;
+    for (const auto& stat : stats)
+        sorted.emplace_back(&stat);
+    std::sort(sorted.begin(), sorted.end(), [](const G4SmartVoxelStat* a, const G4SmartVoxelStat* b)
+              { return a->GetMemoryUse() > b->GetMemoryUse(); });
+
+    const char* kAxes[] = {"x", "y", "z", "rho", "r", "phi"};
+    G4long memory = 0;
+    G4cout << G4endl << "Voxelisation" << G4endl;
+    G4cout << std::setw(24) << std::left << "Volume" << std::right << std::setw(11) << "daughters" << std::setw(11) << "smartless"
+           << std::setw(6) << "axis" << std::setw(8) << "slices" << std::setw(8) << "heads" << std::setw(10) << "nodes"
+           << std::setw(14) << "per node" << std::setw(12) << "memory [kB]" << G4endl;
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        const G4SmartVoxelStat& stat = *sorted.at(i);
+        memory += stat.GetMemoryUse();
+        if (static_cast<G4int>(i) >= fNReport)
+            continue;
+        const G4LogicalVolume* volume = stat.GetVolume();
+        const G4SmartVoxelHeader* header = stat.GetVoxel();
+        G4int axis = header->GetAxis();
+        // Daughters in a node on average, the candidates of each step in the volume
+        G4double perNode = static_cast<G4double>(stat.GetNumberPointers()) / std::max<G4long>(1, stat.GetNumberNodes());
+        G4cout << std::setw(24) << std::left << volume->GetName() << std::right << std::setw(11) << volume->GetNoDaughters()
+               << std::setw(11) << volume->GetSmartless() << std::setw(6) << (axis >= 0 && axis < 6 ? kAxes[axis] : "-")
+               << std::setw(8) << header->GetNoSlices() << std::setw(8) << stat.GetNumberHeads() << std::setw(10) << stat.GetNumberNodes()
+               << std::setw(14) << std::fixed << std::setprecision(2) << perNode
+               << std::setw(12) << std::setprecision(1) << stat.GetMemoryUse() / 1024.0 << std::defaultfloat << G4endl;
+    }
+    if (static_cast<G4int>(stats.size()) > fNReport)
+        G4cout << "... " << stats.size() - fNReport << " more" << G4endl;
+    G4cout << stats.size() << " voxelised volume(s), " << std::fixed << std::setprecision(1) << memory / 1024.0 << " kB of voxels ("
+           << rss << " MB resident), built in " << std::setprecision(3) << time << " s" << std::defaultfloat << G4endl << G4endl;
+
+    RunSummary& summary = config->GetSummary();
+    summary.Set("voxel_volumes", stats.size());
+    summary.Set("voxel_memory", memory);
+    summary.Set("voxel_time", time);
+}
+
+void NavigationBenchmark::Run(G4RunManager* runManager)
+{
+    RunSummary& summary = config->GetSummary();
+    {
+        RunSummary::Scope scope(summary, "voxelisation");
+        ReportVoxels();
+    }
+
+    G4cout << fRays.size() << " rays per pass, " << fNRepeat << " passes" << G4endl;
+    G4cout << std::setw(24) << std::left << "Particle" << std::right << std::setw(14) << "steps/ray" << std::setw(14) << "wall [s]"
+           << std::setw(14) << "CPU [s]" << std::setw(16) << "steps/s" << std::setw(14) << "ns/step" << G4endl;
+    for (const auto& name : fParticles)
+    {
+        G4ParticleDefinition* particle = G4ParticleTable::GetParticleTable()->FindParticle(name);
+        if (!particle)
+        {
+            G4cout << std::setw(24) << std::left << name << std::right << "  unknown particle" << G4endl;
+            continue;
+        }
+        fGun->SetParticleDefinition(particle);
+        {
+            // The first pass includes the physics tables, which the timer leaves out
+            RunSummary::Scope scope(summary, "navigation " + name);
+            runManager->BeamOn(fNRepeat);
+        }
+
+        G4double rate = fNSteps / std::max(1e-9, fCpuTime);
+        G4cout << std::setw(24) << std::left << name << std::right << std::fixed
+               << std::setw(14) << std::setprecision(1) << static_cast<G4double>(fNSteps) / (fRays.size() * fNRepeat)
+               << std::setw(14) << std::setprecision(3) << fWallTime << std::setw(14) << fCpuTime
+               << std::setw(16) << std::setprecision(0) << rate << std::setw(14) << std::setprecision(1) << 1e9 / std::max(1.0, rate)
+               << std::defaultfloat << G4endl;
+        summary.Set(name + "_steps", fNSteps);
+        summary.Set(name + "_steps_per_s", rate);
+    }
+    G4cout << G4endl;
+}
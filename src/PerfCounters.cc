@@ -0,0 +1,192 @@
+#include "PerfCounters.hh"
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+PerfCounters* PerfCounters::fgInstance = 0;
+thread_local PerfCounters::Thread* PerfCounters::fgThread = 0;
+
+namespace
+{
+    const std::uint64_t kConfig[PerfCounters::kNCounters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                             PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    const char* kName[PerfCounters::kNCounters] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+    int OpenCounter(const std::uint64_t& config)
+    {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // The calling thread on any CPU; kernel time is left out where perf_event_paranoid forbids it
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0 && errno == EACCES)
+        {
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+        return fd;
+    }
+}
+
+PerfCounters* PerfCounters::Instance()
+{
+    return fgInstance;
+}
+
+const char* PerfCounters::GetName(const int& counter)
+{
+    return kName[counter];
+}
+
+PerfCounters::PerfCounters() : fFirst(true), fError(0)
+{
+    fgInstance = this;
+    for (int i = 0; i < kNCounters; i++)
+        fAvailable[i] = false;
+
+    // Counters of the main thread, which also tell which ones are available
+    Open();
+    if (!IsAvailable())
+        std::cout << "Hardware counters are not available (" << std::strerror(fError)
+                  << "; see /proc/sys/kernel/perf_event_paranoid), and are not recorded." << std::endl;
+    else
+        for (int i = 0; i < kNCounters; i++)
+            if (!fAvailable[i])
+                std::cout << "Hardware counter " << kName[i] << " is not available, and reads 0." << std::endl;
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (auto thread : fThreads)
+    {
+        for (int i = 0; i < kNCounters; i++)
+            if (thread->fFd[i] >= 0)
+                close(thread->fFd[i]);
+        delete thread;
+    }
+    fgThread = 0;
+    fgInstance = 0;
+}
+
+bool PerfCounters::IsAvailable() const
+{
+    for (int i = 0; i < kNCounters; i++)
+        if (fAvailable[i])
+            return true;
+    return false;
+}
+
+void PerfCounters::Open()
+{
+    fgThread = new Thread();
+    int error = 0;
+    for (int i = 0; i < kNCounters; i++)
+        if ((fgThread->fFd[i] = OpenCounter(kConfig[i])) < 0)
+            error = errno;
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fFirst)
+    {
+        for (int i = 0; i < kNCounters; i++)
+            fAvailable[i] = fgThread->fFd[i] >= 0;
+        fError = error;
+    }
+    fFirst = false;
+    fThreads.emplace_back(fgThread);
+}
+
+PerfCounters::Sample PerfCounters::Read()
+{
+    Thread& thread = GetThread();
+    Sample sample;
+    for (int i = 0; i < kNCounters; i++)
+    {
+        // Value, time enabled and time running
+        std::uint64_t value[3];
+        if (thread.fFd[i] < 0 || read(thread.fFd[i], value, sizeof(value)) != sizeof(value))
+            continue;
+        sample.fCount[i] = value[2] > 0 ? static_cast<double>(value[0]) * value[1] / value[2] : 0.0;
+    }
+    return sample;
+}
+
+void PerfCounters::BeginOfRun()
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (auto thread : fThreads)
+    {
+        thread->fTotal = Sample();
+        thread->fNEvents = thread->fNSteps = 0;
+    }
+}
+
+void PerfCounters::BeginOfEvent()
+{
+    GetThread().fStart = Read();
+}
+
+PerfCounters::Sample PerfCounters::EndOfEvent(const long& nSteps)
+{
+    Thread& thread = GetThread();
+    Sample event = Read() - thread.fStart;
+    thread.fTotal += event;
+    thread.fNEvents++;
+    thread.fNSteps += nSteps;
+    return event;
+}
+
+PerfCounters::Sample PerfCounters::GetTotal(long& nEvents, long& nSteps)
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    Sample total;
+    nEvents = nSteps = 0;
+    for (auto thread : fThreads)
+    {
+        total += thread->fTotal;
+        nEvents += thread->fNEvents;
+        nSteps += thread->fNSteps;
+    }
+    return total;
+}
+
+void PerfCounters::Print(std::ostream& out, const double& wall)
+{
+    long nEvents = 0, nSteps = 0;
+    Sample total = GetTotal(nEvents, nSteps);
+    if (nEvents == 0 || !IsAvailable())
+        return;
+
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "Hardware counters per event:";
+    for (int i = 0; i < kNCounters; i++)
+        if (fAvailable[i])
+            out << " " << std::setprecision(4) << total.fCount[i] / nEvents << " " << kName[i] << ",";
+    out << " IPC " << std::setprecision(3) << total.IPC();
+    if (nSteps > 0)
+    {
+        out << "; per step: " << std::setprecision(4) << total.fCount[kCycles] / nSteps << " cycles, "
+            << total.fCount[kCacheMisses] / nSteps << " cache misses, " << total.fCount[kBranchMisses] / nSteps << " branch misses";
+        if (wall > 0.0)
+            out << ", " << nSteps / wall << " steps/s";
+    }
+    out << std::endl;
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fThreads.size() > 1)
+        for (std::size_t i = 0; i < fThreads.size(); i++)
+            if (fThreads[i]->fNEvents > 0)
+                out << "  thread " << i << ": " << fThreads[i]->fNEvents << " events, " << fThreads[i]->fTotal.fCount[kCycles]
+                    << " cycles, IPC " << fThreads[i]->fTotal.IPC() << std::endl;
+    out << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
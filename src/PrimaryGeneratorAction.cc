@@ -59,6 +59,15 @@ void PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
     // Set random particle position
     // Create vertex
     fHistoManager_Particle->fParticleInfo.reset();
+
+    // Reseed for every event, so that any event can be reproduced on its own
+    G4long eventID = config->GetFirstEvent() + anEvent->GetEventID();
+    std::uint64_t eventSeed = config->GetEventSeed(eventID);
+    long seeds[2] = {static_cast<long>(eventSeed % 2147483562) + 1, static_cast<long>((eventSeed >> 32) % 2147483398) + 1};
+    CLHEP::HepRandom::setTheSeeds(seeds);
+    fHistoManager_Particle->fParticleInfo.fEventID = eventID;
+    fHistoManager_Particle->fParticleInfo.fEventSeed = eventSeed;
+
     if (useHEPEvt)
     {
 //        HEPEvt->GeneratePrimaryVertex(anEvent);
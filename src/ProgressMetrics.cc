@@ -0,0 +1,107 @@
+#include "ProgressMetrics.hh"
+#include "ResourceUsage.hh"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+ProgressMetrics* ProgressMetrics::fgInstance = 0;
+
+namespace
+{
+    const char* kState[3] = {"initialising", "running", "done"};
+}
+
+ProgressMetrics* ProgressMetrics::Instance()
+{
+    return fgInstance;
+}
+
+ProgressMetrics::ProgressMetrics(const std::string& file, const double& interval)
+  : fFile(file), fInterval(interval > 0.1 ? interval : 0.1), fEvents(0), fSteps(0), fBytes(0), fTarget(0),
+    fRunStart(-1.0), fState(0), fJobStart(ResourceUsage::WallTime()), fStop(false)
+{
+    fgInstance = this;
+    Write();
+    fThread = std::thread(&ProgressMetrics::Loop, this);
+}
+
+ProgressMetrics::~ProgressMetrics()
+{
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fStop = true;
+    }
+    fWake.notify_all();
+    fThread.join();
+    Write();
+    fgInstance = 0;
+}
+
+void ProgressMetrics::BeginOfRun(const long& nEvents)
+{
+    fEvents = fSteps = 0;
+    fTarget = nEvents;
+    fRunStart = ResourceUsage::WallTime();
+    fState = 1;
+}
+
+void ProgressMetrics::EndOfRun()
+{
+    fState = 2;
+    fWake.notify_all();
+}
+
+void ProgressMetrics::Loop()
+{
+    std::unique_lock<std::mutex> lock(fMutex);
+    while (!fStop)
+    {
+        fWake.wait_for(lock, std::chrono::duration<double>(fInterval));
+        if (!fStop)
+            Write();
+    }
+}
+
+void ProgressMetrics::Write()
+{
+    double now = ResourceUsage::WallTime();
+    long events = fEvents.load(std::memory_order_relaxed);
+    long steps = fSteps.load(std::memory_order_relaxed);
+    long target = fTarget;
+    double runStart = fRunStart;
+    double elapsed = runStart >= 0.0 ? now - runStart : 0.0;
+    double eventRate = elapsed > 0.0 ? events / elapsed : 0.0;
+    double stepRate = elapsed > 0.0 ? steps / elapsed : 0.0;
+    // -1 until the first event gives a rate
+    double eta = eventRate > 0.0 ? (target - events) / eventRate : -1.0;
+    int state = fState;
+
+    std::vector<std::pair<std::string, double>> metrics = {
+        {"events_done", events}, {"events_total", target}, {"events_per_second", eventRate}, {"eta_seconds", eta},
+        {"steps_per_second", stepRate}, {"peak_rss_megabytes", ResourceUsage::PeakRSS()}, {"rss_megabytes", ResourceUsage::RSS()},
+        {"bytes_written", fBytes.load(std::memory_order_relaxed)}, {"uptime_seconds", now - fJobStart}, {"state", state}};
+
+    // The rename replaces the file at once
+    std::string tmp = fFile + ".tmp";
+    {
+        std::ofstream out(tmp);
+        out << std::setprecision(10);
+        bool prometheus = fFile.size() > 5 && fFile.compare(fFile.size() - 5, 5, ".prom") == 0;
+        if (prometheus)
+        {
+            for (const auto& metric : metrics)
+                out << "# TYPE calo_" << metric.first << " gauge\ncalo_" << metric.first << " " << metric.second << "\n";
+        }
+        else
+        {
+            out << "{\n  \"state_name\": \"" << kState[state] << "\"";
+            for (const auto& metric : metrics)
+                out << ",\n  \"" << metric.first << "\": " << metric.second;
+            out << "\n}\n";
+        }
+        if (!out.good())
+            return;
+    }
+    std::rename(tmp.c_str(), fFile.c_str());
+}
@@ -1,6 +1,12 @@
 #include "RunAction.hh"
 #include "HistoManager.hh"
 #include "PrimaryGeneratorAction.hh"
+#include "ShowerLibrary.hh"
+#include "StepProfiler.hh"
+#include "PerfCounters.hh"
+#include "ProgressMetrics.hh"
+#include "AllocationCounter.hh"
+#include "ResourceUsage.hh"
 
 #include "G4Run.hh"
 #include "G4RunManager.hh"
@@ -8,25 +14,46 @@
 #include "G4PhysicalConstants.hh"
 #include "G4SystemOfUnits.hh"
 #include <iomanip>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    const G4int    kLatencyBinsPerDecade = 20;
+    const G4double kLatencyMin = 1e-6;    // s
+    const G4int    kLatencyBins = 10 * kLatencyBinsPerDecade;
+    // Slow events are only flagged once the percentile is estimated from enough events
+    const G4long   kLatencyWarmUp = 100;
+}
 
 RunAction::RunAction(PrimaryGeneratorAction* kin,HistoManager* histo,Config* c)
  : fPrimary(kin), fHistoManager(histo), config(c)
-{}
+{
+    fSlowPercentile = config->conf["Profile"]["slow_percentile"].as<G4double>(0.0);
+}
 
 RunAction::~RunAction()
 { 
 //    delete fHistoManager;
 }
 
-void RunAction::BeginOfRunAction(const G4Run*)
+void RunAction::BeginOfRunAction(const G4Run* run)
 { 
     G4cout << "....................00000000000000000000...................." << G4endl;
+    config->GetSummary().Stop("physics tables");
 
     // Initialise arrays
     fDecayCount = fTimeCount = 0;
     for (G4int i = 0; i < 3; i++)
         fEkinTot[i] = fPbalance[i] = fEventTime[i] = 0.0;
     fPrimaryTime = 0.0;
+    for (G4int i = 0; i < 4; i++)
+        fEnergyBalance[i] = 0.0;
+    fNLocal = fNRoulette = fNKilledTracks = 0;
+    fNAborted = 0;
+    fLatency.assign(kLatencyBins + 2, 0);
+    fNLatency = fStepSum = fCellSum = 0;
+    fLatencyMax = fLatencySum[0] = fLatencySum[1] = 0.0;
           
     // Histograms
     G4AnalysisManager* analysisManager = G4AnalysisManager::Instance();
@@ -36,7 +63,26 @@ void RunAction::BeginOfRunAction(const G4Run*)
     // Inform the runManager to save random number seed
     G4RunManager::GetRunManager()->SetRandomNumberStore(false);
 
-    fHistoManager->book();
+    {
+        RunSummary::Scope scope(config->GetSummary(), "book");
+        fHistoManager->book();
+    }
+    if (ShowerLibrary::Instance())
+        ShowerLibrary::Instance()->Open();
+    if (StepProfiler::Instance())
+        StepProfiler::Instance()->BeginOfRun();
+    if (PerfCounters::Instance())
+        PerfCounters::Instance()->BeginOfRun();
+    fHistoManager->fRunInfo.fConfigHash = config->GetConfigHash();
+    fHistoManager->fRunInfo.fSeed = config->GetSeed();
+    fHistoManager->fRunInfo.fShard = config->conf["Global"]["shard"].as<G4int>(0);
+
+    // Only the checkpoints may update the tree header, so that it always matches the saved random state
+    if (config->conf["Global"]["checkpoint"].as<G4int>(0) > 0)
+        fHistoManager->fNtuple->SetAutoSave(0);
+    config->GetSummary().Start("events");
+    if (ProgressMetrics::Instance())
+        ProgressMetrics::Instance()->BeginOfRun(run->GetNumberOfEventToBeProcessed());
 }
 
 void RunAction::ParticleCount(G4String name, G4double Ekin)
@@ -101,12 +147,68 @@ void RunAction::PrimaryTiming(G4double ptime)
     fPrimaryTime += ptime;
 }
 
+void RunAction::EnergyBalance(const G4double& primary, const G4double& active, const G4double& passive, const G4double& local, const G4int& nLocal, const G4int& nRoulette)
+{
+    fEnergyBalance[0] += primary;
+    fEnergyBalance[1] += active;
+    fEnergyBalance[2] += passive;
+    fEnergyBalance[3] += local;
+    fNLocal += nLocal;
+    fNRoulette += nRoulette;
+}
+
+void RunAction::BudgetCount(const G4int& nKilledTracks, const G4bool& aborted)
+{
+    fNKilledTracks += nKilledTracks;
+    if (aborted)
+        fNAborted++;
+}
+
+G4bool RunAction::EventLatency(const G4double& wall, const G4double& cpu, const G4long& nSteps, const G4int& nCells)
+{
+    // The threshold is taken before the event is counted, so that it only compares with the earlier ones
+    G4bool slow = fSlowPercentile > 0.0 && fNLatency >= kLatencyWarmUp && wall > LatencyQuantile(fSlowPercentile / 100.0);
+
+    // Bin 0 is the underflow, kLatencyBins + 1 the overflow
+    G4int bin = (wall < kLatencyMin) ? 0 : 1 + static_cast<G4int>(kLatencyBinsPerDecade * std::log10(wall / kLatencyMin));
+    fLatency[std::min(bin, kLatencyBins + 1)]++;
+    fNLatency++;
+    fLatencyMax = std::max(fLatencyMax, wall);
+    fLatencySum[0] += wall;
+    fLatencySum[1] += cpu;
+    fStepSum += nSteps;
+    fCellSum += nCells;
+    return slow;
+}
+
+G4double RunAction::LatencyQuantile(const G4double& q) const
+{
+    // Upper edge of the bin where the cumulative count reaches q
+    G4long target = static_cast<G4long>(std::ceil(q * fNLatency));
+    G4long sum = 0;
+    for (G4int bin = 0; bin <= kLatencyBins; bin++)
+    {
+        sum += fLatency[bin];
+        if (sum >= std::max<G4long>(1, target))
+            return std::min(fLatencyMax, kLatencyMin * std::pow(10.0, static_cast<G4double>(bin) / kLatencyBinsPerDecade));
+    }
+    return fLatencyMax;
+}
+
 void RunAction::EndOfRunAction(const G4Run* run)
 {
     G4cout << "....................55555555555555555555...................." << G4endl;
+    config->GetSummary().Stop("events");
+    if (ProgressMetrics::Instance())
+        ProgressMetrics::Instance()->EndOfRun();
     G4int nbEvents = run->GetNumberOfEvent();
+    config->SetProcessedEvents(nbEvents);
+    if (ShowerLibrary::Instance())
+        ShowerLibrary::Instance()->Close();
     if (nbEvents == 0)
         return;
+    if (StepProfiler::Instance())
+        StepProfiler::Instance()->EndOfRun();
  
     G4ParticleDefinition* particle = fPrimary->GetParticleGun()->GetParticleDefinition();
     G4String partName = particle->GetParticleName();
@@ -183,6 +285,74 @@ void RunAction::EndOfRunAction(const G4Run* run)
            << " Ci/g)" 
            << G4endl << G4endl;
                                             
+    // Energy balance; the rest escapes, or is spent on binding energies and neutrinos
+    if (fEnergyBalance[0] > 0.0)
+    {
+        G4cout << "Energy balance per event: primary " << G4BestUnit(fEnergyBalance[0] / nbEvents, "Energy")
+               << ", active " << G4BestUnit(fEnergyBalance[1] / nbEvents, "Energy")
+               << ", passive " << G4BestUnit(fEnergyBalance[2] / nbEvents, "Energy")
+               << ", local deposit " << G4BestUnit(fEnergyBalance[3] / nbEvents, "Energy")
+               << " (" << 100.0 * fEnergyBalance[3] / fEnergyBalance[0] << "%, " << fNLocal << " particles killed)"
+               << ", rest " << G4BestUnit((fEnergyBalance[0] - fEnergyBalance[1] - fEnergyBalance[2] - fEnergyBalance[3]) / nbEvents, "Energy")
+               << G4endl << G4endl;
+    }
+    if (fNRoulette > 0)
+        G4cout << "Russian roulette killed " << fNRoulette << " neutrons" << G4endl << G4endl;
+    if (fNKilledTracks > 0 || fNAborted > 0)
+        G4cout << "Budgets exceeded: " << fNKilledTracks << " tracks killed, " << fNAborted << " events aborted (see the Status branch)" << G4endl << G4endl;
+
+    // Event latency; quantiles are upper edges of the histogram bins, within 12% of the true values
+    if (fNLatency > 0)
+    {
+        G4cout << "Event latency: p50 " << LatencyQuantile(0.5) << " s, p99 " << LatencyQuantile(0.99) << " s, max " << fLatencyMax
+               << " s, mean " << fLatencySum[0] / fNLatency << " s wall, " << fLatencySum[1] / fNLatency << " s CPU, "
+               << fNLatency / std::max(1e-9, fLatencySum[0]) << " events/s, " << fStepSum / fNLatency << " steps and "
+               << fCellSum / fNLatency << " cells per event" << G4endl;
+        G4long peak = *std::max_element(fLatency.begin(), fLatency.end());
+        for (G4int bin = 0; bin <= kLatencyBins + 1; bin++)
+        {
+            if (fLatency[bin] == 0)
+                continue;
+            G4double low = (bin == 0) ? 0.0 : kLatencyMin * std::pow(10.0, static_cast<G4double>(bin - 1) / kLatencyBinsPerDecade);
+            G4cout << "  " << std::setw(10) << low << " s " << std::setw(8) << fLatency[bin] << " "
+                   << G4String(std::max<G4long>(1, 50 * fLatency[bin] / peak), '#') << G4endl;
+        }
+        G4cout << G4endl;
+
+        RunSummary& summary = config->GetSummary();
+        summary.Set("events", fNLatency);
+        summary.Set("events_per_s", fNLatency / std::max(1e-9, summary.GetWallTime("events")));
+        summary.Set("steps_per_event", static_cast<G4double>(fStepSum) / fNLatency);
+        summary.Set("latency_p50", LatencyQuantile(0.5));
+        summary.Set("latency_p99", LatencyQuantile(0.99));
+        summary.Set("latency_max", fLatencyMax);
+
+        // Memory of the job, and of the buffers of the event loop
+        summary.Set("event_buffer_bytes", fHistoManager->fParticleInfo.GetCapacityBytes());
+        summary.Set("basket_bytes", fHistoManager->GetBasketBytes());
+        G4cout << "Memory: peak RSS " << ResourceUsage::PeakRSS() << " MB, RSS " << ResourceUsage::RSS() << " MB, event buffers "
+               << fHistoManager->fParticleInfo.GetCapacityBytes() / 1024.0 << " kB, tree baskets " << fHistoManager->GetBasketBytes() / 1024.0
+               << " kB" << G4endl << G4endl;
+#ifdef CALO_ALLOC_COUNT
+        AllocationCounter::Print(G4cout, fNLatency - AllocationCounter::kWarmUp);
+#endif
+
+        // Hardware counters, next to the steps per second
+        long nCounted = 0, nSteps = 0;
+        if (PerfCounters::Instance() && PerfCounters::Instance()->IsAvailable())
+        {
+            PerfCounters::Instance()->Print(G4cout, fLatencySum[0]);
+            PerfCounters::Sample total = PerfCounters::Instance()->GetTotal(nCounted, nSteps);
+            summary.Set("ipc", total.IPC());
+            if (nSteps > 0)
+            {
+                summary.Set("cycles_per_step", total.fCount[PerfCounters::kCycles] / nSteps);
+                summary.Set("cache_misses_per_step", total.fCount[PerfCounters::kCacheMisses] / nSteps);
+                summary.Set("branch_misses_per_step", total.fCount[PerfCounters::kBranchMisses] / nSteps);
+            }
+        }
+    }
+
     // Remove all contents in fParticleCount
     fParticleCount.clear(); 
     fEmean.clear();
@@ -207,5 +377,6 @@ void RunAction::EndOfRunAction(const G4Run* run)
         analysisManager->CloseFile();
     } 
 
-    fHistoManager->save();
+    RunSummary::Scope scope(config->GetSummary(), "save");
+    fHistoManager->save(config->GetFirstEvent() + nbEvents);
 }
\ No newline at end of file
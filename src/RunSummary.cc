@@ -0,0 +1,120 @@
+#include "RunSummary.hh"
+#include "Trace.hh"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+void RunSummary::Start(const std::string& phase)
+{
+    Phase entry;
+    entry.fName = phase;
+    entry.fDepth = fDepth++;
+    // Times are kept as start values until the phase stops
+    entry.fWall = ResourceUsage::WallTime();
+    entry.fCpu = ResourceUsage::CpuTime();
+    entry.fRssStart = ResourceUsage::RSS();
+    CALO_TRACE_BEGIN(Trace::Intern(phase));
+    if (fCounters && fCounters->IsAvailable())
+    {
+        entry.fCounted = true;
+        entry.fCounts = fCounters->Read();
+    }
+    fPhases.emplace_back(entry);
+}
+
+void RunSummary::Stop(const std::string& phase)
+{
+    // The innermost open phase of this name
+    for (auto entry = fPhases.rbegin(); entry != fPhases.rend(); ++entry)
+        if (entry->fName == phase && !entry->fDone)
+        {
+            entry->fWall = ResourceUsage::WallTime() - entry->fWall;
+            entry->fCpu = ResourceUsage::CpuTime() - entry->fCpu;
+            entry->fRss = ResourceUsage::RSS();
+            if (entry->fCounted)
+            {
+                if (fCounters)
+                    entry->fCounts = fCounters->Read() - entry->fCounts;
+                else
+                    entry->fCounted = false;
+            }
+            entry->fDone = true;
+            CALO_TRACE_END(Trace::Intern(phase));
+            fDepth = entry->fDepth;
+            fPeakRss = ResourceUsage::PeakRSS();
+            return;
+        }
+}
+
+void RunSummary::Set(const std::string& key, const double& value)
+{
+    for (auto& item : fValues)
+        if (item.first == key)
+        {
+            item.second = value;
+            return;
+        }
+    fValues.emplace_back(key, value);
+}
+
+double RunSummary::GetWallTime(const std::string& phase) const
+{
+    for (auto entry = fPhases.rbegin(); entry != fPhases.rend(); ++entry)
+        if (entry->fName == phase && entry->fDone)
+            return entry->fWall;
+    return 0.0;
+}
+
+void RunSummary::Print(std::ostream& out) const
+{
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    bool counted = std::any_of(fPhases.begin(), fPhases.end(), [](const Phase& entry) { return entry.fCounted; });
+    out << "==================== Job phases ====================" << std::endl << std::endl;
+    out << std::left << std::setw(28) << "Phase" << std::right << std::setw(12) << "wall [s]" << std::setw(12) << "CPU [s]"
+        << std::setw(12) << "RSS [MB]" << std::setw(12) << "dRSS [MB]";
+    if (counted)
+        out << std::setw(12) << "Gcycles" << std::setw(8) << "IPC";
+    out << std::endl;
+    out << std::fixed;
+    for (const auto& entry : fPhases)
+    {
+        if (!entry.fDone)
+            continue;
+        out << std::left << std::setw(28) << std::string(2 * entry.fDepth, ' ') + entry.fName << std::right
+            << std::setprecision(3) << std::setw(12) << entry.fWall << std::setw(12) << entry.fCpu
+            << std::setprecision(1) << std::setw(12) << entry.fRss << std::setw(12) << entry.fRss - entry.fRssStart;
+        if (entry.fCounted)
+            out << std::setprecision(3) << std::setw(12) << 1e-9 * entry.fCounts.fCount[PerfCounters::kCycles]
+                << std::setprecision(2) << std::setw(8) << entry.fCounts.IPC();
+        out << std::endl;
+    }
+    out << "Peak RSS " << std::setprecision(1) << std::max(fPeakRss, ResourceUsage::PeakRSS()) << " MB" << std::endl << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool RunSummary::Write(const std::string& file) const
+{
+    std::ofstream out(file);
+    out << std::setprecision(9) << "{\n  \"phases\": [";
+    bool first = true;
+    for (const auto& entry : fPhases)
+    {
+        if (!entry.fDone)
+            continue;
+        out << (first ? "\n" : ",\n") << "    {\"name\": \"" << entry.fName << "\", \"depth\": " << entry.fDepth
+            << ", \"wall\": " << entry.fWall << ", \"cpu\": " << entry.fCpu
+            << ", \"rss\": " << entry.fRss << ", \"rss_delta\": " << entry.fRss - entry.fRssStart;
+        if (entry.fCounted)
+            for (int i = 0; i < PerfCounters::kNCounters; i++)
+                out << ", \"" << PerfCounters::GetName(i) << "\": " << entry.fCounts.fCount[i];
+        out << "}";
+        first = false;
+    }
+    out << "\n  ],\n  \"peak_rss\": " << std::max(fPeakRss, ResourceUsage::PeakRSS());
+    for (const auto& item : fValues)
+        out << ",\n  \"" << item.first << "\": " << item.second;
+    out << "\n}\n";
+    return out.good();
+}
@@ -0,0 +1,255 @@
+#include "ShowerLibrary.hh"
+#include "Config.hh"
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "G4Gamma.hh"
+#include "G4Region.hh"
+#include "G4LogicalVolume.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+#include <TFile.h>
+#include <TTree.h>
+#include <TDirectory.h>
+#include <algorithm>
+#include <cmath>
+
+ShowerLibrary* ShowerLibrary::fgInstance = 0;
+ShowerLibrary* ShowerLibrary::Instance()
+{
+    return fgInstance;
+}
+
+ShowerLibrary::ShowerLibrary(Config* c)
+ : fRegion(0), fActive(0), fFront(0.0), fThickness(0.0), fFile(0), fTree(0)
+{
+    fgInstance = this;
+    fGenerate = c->conf["FastSim"]["frozen_generate"].as<std::string>("");
+    fEmin = c->conf["FastSim"]["frozen_emin"].as<G4double>(0.01) * GeV;
+    fEmax = c->conf["FastSim"]["frozen_emax"].as<G4double>(1.0) * GeV;
+    fNEnergyBins = c->conf["FastSim"]["frozen_ebins"].as<G4int>(10);
+    fNPositionBins = c->conf["FastSim"]["frozen_zbins"].as<G4int>(6);
+
+    G4String library = c->conf["FastSim"]["frozen_library"].as<std::string>("");
+    if (!fGenerate.empty() && !library.empty())
+        G4cout << "Both frozen_generate and frozen_library are set; the library is not used while generating a new one." << G4endl;
+    else if (!library.empty())
+        Load(library);
+}
+
+ShowerLibrary::~ShowerLibrary()
+{
+    fgInstance = 0;
+}
+
+G4bool ShowerLibrary::GetBin(const G4ParticleDefinition* particle, const G4double& energy, const G4double& z, std::tuple<G4int, G4int, G4int>& bin) const
+{
+    if (energy < fEmin || energy >= fEmax || fThickness <= 0.0)
+        return false;
+
+    G4int type = -1;
+    if (particle == G4Electron::Definition() || particle == G4Positron::Definition())
+        type = 0;
+    else if (particle == G4Gamma::Definition())
+        type = 1;
+    else
+        return false;
+
+    G4int energyBin = static_cast<G4int>(fNEnergyBins * std::log(energy / fEmin) / std::log(fEmax / fEmin));
+    G4double position = std::fmod(z - fFront, fThickness) / fThickness;
+    if (position < 0.0)
+        position += 1.0;
+    G4int positionBin = std::min(static_cast<G4int>(fNPositionBins * position), fNPositionBins - 1);
+    bin = std::make_tuple(type, std::min(energyBin, fNEnergyBins - 1), positionBin);
+    return true;
+}
+
+const FrozenShower* ShowerLibrary::Draw(const std::tuple<G4int, G4int, G4int>& bin) const
+{
+    auto it = fShowers.find(bin);
+    if (it == fShowers.end() || it->second.empty())
+        return nullptr;
+    size_t i = std::min(static_cast<size_t>(G4UniformRand() * it->second.size()), it->second.size() - 1);
+    return &it->second.at(i);
+}
+
+void ShowerLibrary::Load(const G4String& fname)
+{
+    TFile* file = TFile::Open(fname.c_str(), "READ");
+    TTree* tree = nullptr;
+    if (file && !file->IsZombie())
+        file->GetObject("FrozenShowers", tree);
+    if (!tree)
+    {
+        G4cout << "Frozen-shower library " << fname << " cannot be read; the HCAL is fully simulated." << G4endl;
+        delete file;
+        return;
+    }
+
+    Double_t emin = 0.0, emax = 0.0;
+    Int_t nEnergyBins = 0, nPositionBins = 0;
+    TTree* settings = nullptr;
+    file->GetObject("FrozenSettings", settings);
+    if (settings)
+    {
+        // The binning of the library overrides the YAML file
+        settings->SetBranchAddress("Emin", &emin);
+        settings->SetBranchAddress("Emax", &emax);
+        settings->SetBranchAddress("NEnergyBins", &nEnergyBins);
+        settings->SetBranchAddress("NPositionBins", &nPositionBins);
+        settings->GetEntry(0);
+        fEmin = emin;
+        fEmax = emax;
+        fNEnergyBins = nEnergyBins;
+        fNPositionBins = nPositionBins;
+    }
+
+    Int_t type, energyBin, positionBin;
+    Double_t energy;
+    std::vector<Float_t>* l = nullptr;
+    std::vector<Float_t>* t1 = nullptr;
+    std::vector<Float_t>* t2 = nullptr;
+    std::vector<Float_t>* e = nullptr;
+    tree->SetBranchAddress("Type", &type);
+    tree->SetBranchAddress("EnergyBin", &energyBin);
+    tree->SetBranchAddress("PositionBin", &positionBin);
+    tree->SetBranchAddress("Energy", &energy);
+    tree->SetBranchAddress("L", &l);
+    tree->SetBranchAddress("T1", &t1);
+    tree->SetBranchAddress("T2", &t2);
+    tree->SetBranchAddress("E", &e);
+
+    for (Long64_t i = 0; i < tree->GetEntries(); i++)
+    {
+        tree->GetEntry(i);
+        FrozenShower shower;
+        shower.fEnergy = energy;
+        for (size_t j = 0; j < e->size(); j++)
+            shower.fSpots.emplace_back(FrozenSpot{l->at(j), t1->at(j), t2->at(j), e->at(j)});
+        fShowers[std::make_tuple(type, energyBin, positionBin)].emplace_back(shower);
+    }
+    G4cout << "Frozen-shower library " << fname << ": " << tree->GetEntries() << " showers in " << fShowers.size() << " bins, "
+           << fEmin / MeV << " - " << fEmax / MeV << " MeV" << G4endl;
+
+    file->Close();
+    delete file;
+}
+
+void ShowerLibrary::Open()
+{
+    if (fGenerate.empty())
+        return;
+
+    // Keep the current directory, where the event tree is booked
+    TDirectory::TContext context;
+    fFile = new TFile(fGenerate.c_str(), "RECREATE");
+    fTree = new TTree("FrozenShowers", "Frozen EM showers in the HCAL");
+    fTree->Branch("Type",        &fType,        "Type/I");
+    fTree->Branch("EnergyBin",   &fEnergyBin,   "EnergyBin/I");
+    fTree->Branch("PositionBin", &fPositionBin, "PositionBin/I");
+    fTree->Branch("Energy",      &fEnergy,      "Energy/D");
+    fTree->Branch("L",           &fL);
+    fTree->Branch("T1",          &fT1);
+    fTree->Branch("T2",          &fT2);
+    fTree->Branch("E",           &fE);
+}
+
+void ShowerLibrary::BeginTrack(const G4Track* track)
+{
+    if (!fTree)
+        return;
+
+    // Descendants are part of the shower of their ancestor
+    auto parent = fRootOf.find(track->GetParentID());
+    if (parent != fRootOf.end())
+    {
+        fRootOf[track->GetTrackID()] = parent->second;
+        return;
+    }
+
+    std::tuple<G4int, G4int, G4int> bin;
+    if (!track->GetVolume() || track->GetVolume()->GetLogicalVolume()->GetRegion() != fRegion
+        || !GetBin(track->GetDefinition(), track->GetKineticEnergy(), track->GetPosition().z(), bin))
+        return;
+
+    Root root;
+    root.fBin = bin;
+    root.fPosition = track->GetPosition();
+    root.fDirection = track->GetMomentumDirection();
+    root.fT1 = root.fDirection.orthogonal().unit();
+    root.fT2 = root.fDirection.cross(root.fT1);
+    root.fEnergy = track->GetKineticEnergy();
+    fRootOf[track->GetTrackID()] = fRoots.size();
+    fRoots.emplace_back(root);
+}
+
+void ShowerLibrary::AddStep(const G4Step* step, const G4int& copyNo, const G4double& edep)
+{
+    if (!fTree || edep <= 0.0)
+        return;
+
+    auto it = fRootOf.find(step->GetTrack()->GetTrackID());
+    if (it == fRootOf.end())
+        return;
+
+    // Energy-weighted position in each cell
+    Root& root = fRoots.at(it->second);
+    G4ThreeVector d = 0.5 * (step->GetPreStepPoint()->GetPosition() + step->GetPostStepPoint()->GetPosition()) - root.fPosition;
+    FrozenSpot& spot = root.fCells[copyNo];
+    spot.fL += edep * d.dot(root.fDirection);
+    spot.fT1 += edep * d.dot(root.fT1);
+    spot.fT2 += edep * d.dot(root.fT2);
+    spot.fE += edep;
+}
+
+void ShowerLibrary::EndOfEvent()
+{
+    if (!fTree)
+        return;
+
+    for (const auto& root : fRoots)
+    {
+        fType = std::get<0>(root.fBin);
+        fEnergyBin = std::get<1>(root.fBin);
+        fPositionBin = std::get<2>(root.fBin);
+        fEnergy = root.fEnergy;
+        fL.clear();
+        fT1.clear();
+        fT2.clear();
+        fE.clear();
+        for (const auto& cell : root.fCells)
+        {
+            fL.emplace_back(cell.second.fL / cell.second.fE);
+            fT1.emplace_back(cell.second.fT1 / cell.second.fE);
+            fT2.emplace_back(cell.second.fT2 / cell.second.fE);
+            fE.emplace_back(cell.second.fE);
+        }
+        fTree->Fill();
+    }
+    fRoots.clear();
+    fRootOf.clear();
+}
+
+void ShowerLibrary::Close()
+{
+    if (!fFile)
+        return;
+
+    TDirectory::TContext context(fFile);
+    Double_t emin = fEmin, emax = fEmax;
+    Int_t nEnergyBins = fNEnergyBins, nPositionBins = fNPositionBins;
+    TTree* settings = new TTree("FrozenSettings", "Binning of the frozen-shower library");
+    settings->Branch("Emin", &emin, "Emin/D");
+    settings->Branch("Emax", &emax, "Emax/D");
+    settings->Branch("NEnergyBins", &nEnergyBins, "NEnergyBins/I");
+    settings->Branch("NPositionBins", &nPositionBins, "NPositionBins/I");
+    settings->Fill();
+
+    G4cout << "Frozen-shower library " << fGenerate << ": " << fTree->GetEntries() << " showers recorded" << G4endl;
+    fFile->Write("", TObject::kOverwrite);
+    fFile->Close();
+    delete fFile;
+    fFile = 0;
+    fTree = 0;
+}
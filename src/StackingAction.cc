@@ -0,0 +1,108 @@
+#include "G4Track.hh"
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "G4Gamma.hh"
+#include "G4Neutron.hh"
+#include "Randomize.hh"
+#include "G4Navigator.hh"
+#include "G4TransportationManager.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4EmCalculator.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+
+#include "StackingAction.hh"
+#include "EventAction.hh"
+
+StackingAction::StackingAction(EventAction* event, Config* c)
+ : G4UserStackingAction(),
+   fEventAction(event), config(c), fNavigator(0), fCalculator(0)
+{
+    fEnabled = config->conf["LocalDeposit"]["enable"].as<G4bool>(false);
+
+    fRouletteSurvival = 1.0;
+    if (config->conf["Biasing"]["roulette"].as<G4bool>(false))
+    {
+        fRouletteEmax = config->conf["Biasing"]["roulette_emax"].as<G4double>(1.0) * MeV;
+        fRouletteSurvival = config->conf["Biasing"]["roulette_survival"].as<G4double>(0.1);
+        G4cout << "Russian roulette of neutrons below " << fRouletteEmax / MeV << " MeV, survival probability " << fRouletteSurvival << G4endl;
+    }
+}
+
+StackingAction::~StackingAction()
+{
+    delete fNavigator;
+    delete fCalculator;
+}
+
+void StackingAction::SetUpRules()
+{
+    // One rule per passive logical volume listed in the YAML file; the geometry only exists after initialisation
+    for (auto rule : config->conf["LocalDeposit"])
+    {
+        if (!rule.second.IsMap())
+            continue;
+        G4LogicalVolume* volume = G4LogicalVolumeStore::GetInstance()->GetVolume(rule.first.as<std::string>(), false);
+        if (!volume)
+            continue;
+        fRules[volume] = Rule{rule.second["ecut"].as<G4double>(0.0) * MeV, rule.second["range"].as<G4bool>(false)};
+        G4cout << "Local deposition in " << volume->GetName() << ": e+/e-/gamma below " << rule.second["ecut"].as<G4double>(0.0)
+               << " MeV" << (fRules[volume].fRange ? ", and electrons which cannot leave the volume" : "") << G4endl;
+    }
+
+    fNavigator = new G4Navigator();
+    fNavigator->SetWorldVolume(G4TransportationManager::GetTransportationManager()->GetNavigatorForTracking()->GetWorldVolume());
+    fCalculator = new G4EmCalculator();
+}
+
+G4ClassificationOfNewTrack StackingAction::ClassifyNewTrack(const G4Track* track)
+{
+    if (track->GetParentID() == 0)
+        return fUrgent;
+
+    // Russian roulette of slow neutrons: the survivors carry the weight of the killed ones
+    const G4ParticleDefinition* particle = track->GetDefinition();
+    if (fRouletteSurvival < 1.0 && particle == G4Neutron::Definition() && track->GetKineticEnergy() < fRouletteEmax)
+    {
+        if (G4UniformRand() >= fRouletteSurvival)
+        {
+            fEventAction->AddRouletteKill();
+            return fKill;
+        }
+        const_cast<G4Track*>(track)->SetWeight(track->GetWeight() / fRouletteSurvival);
+        return fUrgent;
+    }
+
+    if (!fEnabled)
+        return fUrgent;
+
+    G4bool electron = (particle == G4Electron::Definition());
+    if (!electron && particle != G4Positron::Definition() && particle != G4Gamma::Definition())
+        return fUrgent;
+
+    if (!fNavigator)
+        SetUpRules();
+    G4VPhysicalVolume* volume = fNavigator->LocateGlobalPointAndSetup(track->GetPosition(), nullptr, false, true);
+    if (!volume)
+        return fUrgent;
+    auto rule = fRules.find(volume->GetLogicalVolume());
+    if (rule == fRules.end())
+        return fUrgent;
+
+    G4double energy = track->GetKineticEnergy();
+    G4bool local = (energy < rule->second.fEcut);
+    if (!local && electron && rule->second.fRange)
+    {
+        // The restricted range is longer than the true one, so this never kills an electron which could escape
+        G4double range = fCalculator->GetRangeFromRestricteDEDX(energy, particle, volume->GetLogicalVolume()->GetMaterial());
+        local = (range < fNavigator->ComputeSafety(track->GetPosition()));
+    }
+    if (!local)
+        return fUrgent;
+
+    // Positrons annihilate where they stop
+    if (particle == G4Positron::Definition())
+        energy += 2.0 * electron_mass_c2;
+    fEventAction->AddLocalDeposit(track->GetWeight() * energy);
+    return fKill;
+}
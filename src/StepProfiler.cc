@@ -0,0 +1,148 @@
+#include "StepProfiler.hh"
+#include "Config.hh"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+StepProfiler* StepProfiler::fgInstance = 0;
+G4ThreadLocal StepProfiler::Table* StepProfiler::fgTable = 0;
+
+StepProfiler* StepProfiler::Instance()
+{
+    return fgInstance;
+}
+
+StepProfiler::StepProfiler(Config* c)
+{
+    fgInstance = this;
+    fSample = std::max<G4long>(1, c->conf["Profile"]["sample"].as<G4long>(100));
+    fOutput = c->conf["Profile"]["output"].as<std::string>("profile.json");
+    fNReport = c->conf["Profile"]["report"].as<G4int>(15);
+}
+
+StepProfiler::~StepProfiler()
+{
+    for (auto table : fTables)
+        delete table;
+    fgTable = 0;
+    fgInstance = 0;
+}
+
+void StepProfiler::Register()
+{
+    fgTable = new Table();
+    G4AutoLock lock(&fMutex);
+    fTables.emplace_back(fgTable);
+}
+
+void StepProfiler::BeginOfRun()
+{
+    G4AutoLock lock(&fMutex);
+    for (auto table : fTables)
+        *table = Table();
+}
+
+namespace
+{
+    class Entry
+    {
+    public:
+        G4long   fSteps = 0;
+        G4long   fTracks = 0;
+        G4double fTime = 0.0;
+    };
+
+    void Print(const G4String& title, const std::map<G4String, Entry>& entries, const G4long& nSteps, const G4double& time, const G4int& nReport)
+    {
+        std::vector<std::pair<G4String, Entry>> sorted(entries.begin(), entries.end());
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<G4String, Entry>& a, const std::pair<G4String, Entry>& b)
+                  { return a.second.fTime != b.second.fTime ? a.second.fTime > b.second.fTime : a.second.fSteps > b.second.fSteps; });
+
+        G4cout << std::setw(24) << std::left << title << std::right << std::setw(14) << "steps" << std::setw(8) << "%"
+               << std::setw(12) << "tracks" << std::setw(12) << "CPU [s]" << std::setw(8) << "%" << G4endl;
+        for (G4int i = 0; i < std::min<G4int>(nReport, sorted.size()); i++)
+        {
+            const Entry& entry = sorted.at(i).second;
+            G4cout << std::setw(24) << std::left << sorted.at(i).first << std::right
+                   << std::setw(14) << entry.fSteps << std::setw(8) << std::fixed << std::setprecision(1) << 100.0 * entry.fSteps / std::max<G4long>(1, nSteps)
+                   << std::setw(12) << entry.fTracks << std::setw(12) << std::setprecision(3) << entry.fTime
+                   << std::setw(8) << std::setprecision(1) << 100.0 * entry.fTime / std::max(1e-9, time) << std::defaultfloat << G4endl;
+        }
+        if (static_cast<G4int>(sorted.size()) > nReport)
+            G4cout << "... " << sorted.size() - nReport << " more" << G4endl;
+        G4cout << G4endl;
+    }
+
+    void Write(std::ofstream& out, const G4String& name, const std::map<G4String, Entry>& entries)
+    {
+        out << "  \"" << name << "\": [";
+        G4bool first = true;
+        for (const auto& entry : entries)
+        {
+            out << (first ? "\n" : ",\n") << "    {\"name\": \"" << entry.first << "\", \"steps\": " << entry.second.fSteps
+                << ", \"tracks\": " << entry.second.fTracks << ", \"cpu\": " << entry.second.fTime << "}";
+            first = false;
+        }
+        out << "\n  ]";
+    }
+}
+
+void StepProfiler::EndOfRun()
+{
+    // Tables of all threads, merged by name
+    std::map<G4String, Entry> volumes, particles, processes;
+    G4long nSteps = 0;
+    G4double time = 0.0;
+    {
+        G4AutoLock lock(&fMutex);
+        for (auto table : fTables)
+        {
+            for (const auto& counter : table->fVolumes)
+                if (counter.fSteps > 0 || counter.fTracks > 0)
+                {
+                    Entry& entry = volumes[counter.fName];
+                    entry.fSteps += counter.fSteps;
+                    entry.fTracks += counter.fTracks;
+                    entry.fTime += counter.fTime;
+                    nSteps += counter.fSteps;
+                    time += counter.fTime;
+                }
+            for (const auto& counter : table->fParticles)
+                if (counter.fSteps > 0 || counter.fTracks > 0)
+                {
+                    Entry& entry = particles[counter.fName];
+                    entry.fSteps += counter.fSteps;
+                    entry.fTracks += counter.fTracks;
+                    entry.fTime += counter.fTime;
+                }
+            // Processes count the steps they limit and the tracks they create
+            for (const auto& item : table->fProcesses)
+            {
+                Entry& entry = processes[item.second.fName];
+                entry.fSteps += item.second.fSteps;
+                entry.fTime += item.second.fTime;
+            }
+            for (const auto& item : table->fCreators)
+                processes[item.second.fName].fTracks += item.second.fTracks;
+        }
+    }
+    if (nSteps == 0)
+        return;
+
+    G4cout << "==================== Step profile ====================" << G4endl << G4endl;
+    G4cout << nSteps << " steps, " << time << " s CPU time sampled on one step in " << fSample << G4endl << G4endl;
+    Print("Volume", volumes, nSteps, time, fNReport);
+    Print("Particle", particles, nSteps, time, fNReport);
+    Print("Process", processes, nSteps, time, fNReport);
+
+    std::ofstream out(fOutput);
+    out << "{\n  \"sample\": " << fSample << ",\n  \"steps\": " << nSteps << ",\n  \"cpu\": " << time << ",\n";
+    Write(out, "volumes", volumes);
+    out << ",\n";
+    Write(out, "particles", particles);
+    out << ",\n";
+    Write(out, "processes", processes);
+    out << "\n}\n";
+    G4cout << "Step profile written into " << fOutput << G4endl << G4endl;
+}
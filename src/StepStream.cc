@@ -0,0 +1,39 @@
+#include "StepStream.hh"
+
+StepStream* StepStream::fgInstance = 0;
+
+StepStream* StepStream::Instance()
+{
+    return fgInstance;
+}
+
+StepStream::StepStream(const std::string& file) : fOut(file, std::ios::binary)
+{
+    fgInstance = this;
+}
+
+StepStream::~StepStream()
+{
+    fgInstance = 0;
+}
+
+bool StepStream::Read(const std::string& file, std::vector<std::vector<Step>>& events)
+{
+    std::ifstream fin(file, std::ios::binary);
+    if (!fin)
+        return false;
+    events.clear();
+    std::vector<Step> event;
+    Step step;
+    while (fin.read(reinterpret_cast<char*>(&step), sizeof(step)))
+    {
+        if (step.fSubdetector == CellID::kNone)
+        {
+            events.emplace_back(std::move(event));
+            event.clear();
+        }
+        else
+            event.emplace_back(step);
+    }
+    return true;
+}
@@ -3,9 +3,13 @@
 #include "G4RunManager.hh"
 #include "G4Step.hh"
 #include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4EventManager.hh"
 //#include "G4EmSaturation.hh"
 
 #include "SteppingAction.hh"
+#include "ShowerLibrary.hh"
+#include "StepProfiler.hh"
 
 SteppingAction* SteppingAction::fgInstance = 0;
 SteppingAction* SteppingAction::Instance()
@@ -13,12 +17,16 @@ SteppingAction* SteppingAction::Instance()
     return fgInstance;
 }
 
-SteppingAction::SteppingAction(DetectorConstruction* det, EventAction* event) 
+SteppingAction::SteppingAction(DetectorConstruction* det, EventAction* event, Config* c) 
  : G4UserSteppingAction(),
    fVolume(0),
-   fDetector(det), fEventAction_Step(event)                                         
+   fDetector(det), fEventAction_Step(event), fStepCounter(0),
+   fProfiler(StepProfiler::Instance())
 {
     fgInstance = this;
+    fMaxSteps = c->conf["Budget"]["track_steps"].as<G4int>(0);
+    fMaxTime = c->conf["Budget"]["track_time"].as<G4double>(0.0) * ns;
+    fMaxWall = c->conf["Budget"]["event_wall"].as<G4double>(0.0);
     kineticEn = 0;
     volume1 = "none";
     volume2 = "none";
@@ -34,25 +42,44 @@ void SteppingAction::UserSteppingAction(const G4Step* aStep)
     //G4EmSaturation* G4Em = new G4EmSaturation();
     //G4Em->SetVerbose(0);
     //G4double edep =   G4Em->VisibleEnergyDeposition(aStep);
-    G4double edep = BirksAttenuation(aStep);
-    G4int copyNo = aStep->GetPreStepPoint()->GetPhysicalVolume()->GetCopyNo();
-    G4int pdgid = aStep->GetTrack()->GetDefinition()->GetPDGEncoding();
-    G4int trackid = aStep->GetTrack()->GetTrackID();
-    G4double time = aStep->GetPreStepPoint()->GetGlobalTime();
-    G4String volumeName = aStep->GetPreStepPoint()->GetTouchableHandle()->GetVolume()->GetLogicalVolume()->GetName();
-    if (time > 150.0)
-        return;
+    if (fProfiler)
+        fProfiler->Step(aStep);
 
-    // check if we are in scoring volume
-    // collect energy and track length step by step
-    //G4cout << volumeName << " " << G4int (volumeName == "ecal_crystal") << " " << edep << G4endl;
-//    if (volumeName == "ecal_crystal")
-//        fEventAction_Step->AddEcalHit(copyNo, edep, time, pdgid, trackid);
-    if (volumeName == "hcal_psd")
-    { 
-        //G4cout << copyNo << " pdg: " << pdgid << " track: " << trackid << " edep: " << edep << G4endl;
-        fEventAction_Step->AddHcalHit(copyNo, edep, time, pdgid, trackid);
+    // Budgets; the wall clock is only read every 1000 steps
+    G4Track* track = aStep->GetTrack();
+    if (fMaxSteps > 0 && track->GetCurrentStepNumber() >= fMaxSteps)
+    {
+        track->SetTrackStatus(fStopAndKill);
+        fEventAction_Step->ExceedBudget(EventAction::kTrackSteps, track);
+    }
+    else if (fMaxTime > 0.0 && track->GetGlobalTime() > fMaxTime)
+    {
+        track->SetTrackStatus(fStopAndKill);
+        fEventAction_Step->ExceedBudget(EventAction::kTrackTime, track);
+    }
+    ++fStepCounter;
+    if (fMaxWall > 0.0 && fStepCounter % 1000 == 0 && fEventAction_Step->GetWallTime() > fMaxWall)
+    {
+        fEventAction_Step->ExceedBudget(EventAction::kEventWall, track);
+        G4EventManager::GetEventManager()->AbortCurrentEvent();
     }
+
+    // The ECAL strips and HCAL tiles are read out alike; volumes are told apart by pointer, not by name
+    G4LogicalVolume* volume = aStep->GetPreStepPoint()->GetTouchableHandle()->GetVolume()->GetLogicalVolume();
+    G4bool hcal = (volume == fDetector->GetHcalActive());
+    G4bool active = (hcal || volume == fDetector->GetEcalActive());
+    // Deposits of biased tracks count with their weight
+    G4double weight = track->GetWeight();
+    fEventAction_Step->AddEdep(weight * aStep->GetTotalEnergyDeposit(), active);
+    if (!active || aStep->GetPreStepPoint()->GetGlobalTime() > 150.0)
+        return;
+
+    G4double edep = BirksAttenuation(aStep);
+    G4int copyNo = aStep->GetPreStepPoint()->GetPhysicalVolume()->GetCopyNo();
+    fEventAction_Step->AddWeight(edep, weight);
+    fEventAction_Step->AddHit(hcal ? CellID::kHcal : CellID::kEcal, copyNo, weight * edep);
+    if (hcal && ShowerLibrary::Instance())
+        ShowerLibrary::Instance()->AddStep(aStep, copyNo, edep);
 }
  
 void SteppingAction::Reset()
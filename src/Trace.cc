@@ -0,0 +1,94 @@
+#include "Trace.hh"
+
+#ifdef CALO_TRACE
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+
+thread_local Trace::Buffer* Trace::fgBuffer = 0;
+const std::chrono::steady_clock::time_point Trace::fgStart = std::chrono::steady_clock::now();
+
+namespace
+{
+    // Events per thread; 24 MB each, the latest 2^20 begins or ends
+    const std::size_t kBufferSize = 1 << 20;
+
+    std::mutex& GetMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // Buffers and names stay until the end of the job, so that the threads may finish before the trace is written
+    std::vector<std::unique_ptr<Trace::Buffer>>& GetBuffers()
+    {
+        static std::vector<std::unique_ptr<Trace::Buffer>> buffers;
+        return buffers;
+    }
+
+    std::set<std::string>& GetNames()
+    {
+        static std::set<std::string> names;
+        return names;
+    }
+
+    void Escape(std::ofstream& out, const char* name)
+    {
+        for (const char* c = name; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                out << '\\';
+            out << *c;
+        }
+    }
+}
+
+Trace::Buffer& Trace::Register()
+{
+    std::lock_guard<std::mutex> lock(GetMutex());
+    GetBuffers().emplace_back(new Buffer());
+    fgBuffer = GetBuffers().back().get();
+    fgBuffer->fEvents.resize(kBufferSize);
+    fgBuffer->fThread = GetBuffers().size();
+    return *fgBuffer;
+}
+
+const char* Trace::Intern(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(GetMutex());
+    return GetNames().insert(name).first->c_str();
+}
+
+bool Trace::Write(const std::string& file)
+{
+    std::lock_guard<std::mutex> lock(GetMutex());
+    std::ofstream out(file);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    int pid = getpid();
+    for (const auto& buffer : GetBuffers())
+    {
+        // Oldest first; after wrapping, the spans whose begin was overwritten still end where they did
+        std::size_t n = buffer->fWrapped ? buffer->fEvents.size() : buffer->fNext;
+        std::size_t start = buffer->fWrapped ? buffer->fNext : 0;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const Event& event = buffer->fEvents[(start + i) % buffer->fEvents.size()];
+            out << (first ? "\n" : ",\n") << "{\"name\": \"";
+            Escape(out, event.fName);
+            out << "\", \"ph\": \"" << event.fPhase << "\", \"ts\": " << event.fTime / 1000 << '.'
+                << std::to_string(1000 + event.fTime % 1000).substr(1) << ", \"pid\": " << pid << ", \"tid\": " << buffer->fThread << "}";
+            first = false;
+        }
+        if (buffer->fWrapped)
+            out << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << buffer->fThread
+                << ", \"args\": {\"name\": \"thread " << buffer->fThread << " (ring buffer wrapped)\"}}";
+    }
+    out << "\n]}\n";
+    return out.good();
+}
+
+#endif
@@ -8,6 +8,8 @@
 #include "HistoManager.hh"
 //#include "Run.hh"
 #include "EventAction.hh"
+#include "ShowerLibrary.hh"
+#include "StepProfiler.hh"
 
 TrackingAction::TrackingAction(RunAction* runAct, EventAction* EA, Config* c)
  : G4UserTrackingAction(),
@@ -29,6 +31,11 @@ void TrackingAction::PreUserTrackingAction(const G4Track* track)
     G4int ID      = track->GetTrackID();
     G4double Ekin = track->GetKineticEnergy();
     fParticleEnCode= particle->GetPDGEncoding();
+
+    if (ShowerLibrary::Instance())
+        ShowerLibrary::Instance()->BeginTrack(track);
+    if (StepProfiler::Instance())
+        StepProfiler::Instance()->Track(track);
 }
   
 void TrackingAction::PostUserTrackingAction(const G4Track* track) {}